@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <gmp.h>
+#include "../utils/util.h"
+#include "chudnovsky.h"
+
+#define DIGITS_PER_TERM 14.181647462725477
+#define GUARD_DIGITS 16
+#define OUTPUT_CHUNK_DIGITS 65536
+
+/* 640320^3 / 24 */
+#define C3_OVER_24 10939058860032000UL
+#define SERIES_A 13591409UL
+#define SERIES_B 545140134UL
+#define FINAL_FACTOR 426880UL
+#define SQRT_ARGUMENT 10005UL
+
+/*****************************************************************************
+ * Binary splitting.
+ ****************************************************************************/
+
+/*
+ * P, Q, T of the term range [from, to). P of a range is only needed when
+ * something is merged to the right of it, so it is skipped for the
+ * rightmost ranges to save memory and one multiplication per level.
+ * Once a range is merged into the one to the left of it, its P, Q, T
+ * are cleared and merged is set.
+ */
+typedef struct split_s {
+    long long from;
+    long long to;
+    int need_p;
+    int merged;
+    mpz_t p;
+    mpz_t q;
+    mpz_t t;
+} split_t;
+
+static void compute_term(long long a, mpz_t p, mpz_t q, mpz_t t) {
+    if (a == 0) {
+        mpz_set_ui(p, 1);
+        mpz_set_ui(q, 1);
+        mpz_set_ui(t, SERIES_A);
+        return;
+    }
+    mpz_set_ui(p, 6 * a - 5);
+    mpz_mul_ui(p, p, 2 * a - 1);
+    mpz_mul_ui(p, p, 6 * a - 1);
+
+    mpz_set_ui(q, a);
+    mpz_mul_ui(q, q, a);
+    mpz_mul_ui(q, q, a);
+    mpz_mul_ui(q, q, C3_OVER_24);
+
+    mpz_mul_ui(t, p, SERIES_A + SERIES_B * a);
+    if (a % 2 == 1) {
+        mpz_neg(t, t);
+    }
+}
+
+/*
+ * Left range (p, q, t) absorbs the right range (p2, q2, t2):
+ * T = T1 Q2 + P1 T2, Q = Q1 Q2, P = P1 P2.
+ */
+static void merge_ranges(mpz_t p, mpz_t q, mpz_t t,
+        mpz_t p2, mpz_t q2, mpz_t t2, int need_p) {
+    mpz_mul(t, t, q2);
+    mpz_mul(t2, t2, p);
+    mpz_add(t, t, t2);
+    mpz_mul(q, q, q2);
+    if (need_p) {
+        mpz_mul(p, p, p2);
+    }
+}
+
+static void binary_split(long long from, long long to, int need_p,
+        mpz_t p, mpz_t q, mpz_t t) {
+    if (to - from == 1) {
+        compute_term(from, p, q, t);
+        return;
+    }
+    long long middle = from + (to - from) / 2;
+    mpz_t p2, q2, t2;
+    mpz_inits(p2, q2, t2, NULL);
+    binary_split(from, middle, 1, p, q, t);
+    binary_split(middle, to, need_p, p2, q2, t2);
+    merge_ranges(p, q, t, p2, q2, t2, need_p);
+    mpz_clears(p2, q2, t2, NULL);
+}
+
+/*****************************************************************************
+ * Threads routine functions.
+ ****************************************************************************/
+
+typedef struct merge_data_s {
+    split_t* left;
+    split_t* right;
+} merge_data_t;
+
+static void* compute_split(void* arg) {
+    split_t* split = (split_t*) arg;
+    binary_split(split->from, split->to, split->need_p,
+                 split->p, split->q, split->t);
+    pthread_exit(NO_RETURN_VALUE);
+}
+
+static void* merge_splits(void* arg) {
+    merge_data_t* data = (merge_data_t*) arg;
+    split_t* left = data->left;
+    split_t* right = data->right;
+    merge_ranges(left->p, left->q, left->t, right->p, right->q, right->t,
+                 right->need_p);
+    left->to = right->to;
+    left->need_p = right->need_p;
+    mpz_clears(right->p, right->q, right->t, NULL);
+    right->merged = 1;
+    pthread_exit(NO_RETURN_VALUE);
+}
+
+static int join_all_threads(pthread_t* threads, int thread_count) {
+    int result = SUCCESS;
+    for (int i = 0; i < thread_count; ++i) {
+        int code = pthread_join(threads[i], NO_RETURN_VALUE);
+        if (code != SUCCESS) {
+            result = code;
+        }
+    }
+    return result;
+}
+
+/*
+ * Function computes leaves [0, split_count) in parallel and then merges
+ * them pairwise level by level: after the round with distance step every
+ * split with index divisible by 2 * step covers 2 * step leaves.
+ * The result ends up in splits[0]; all other splits are cleared.
+ */
+static int compute_all_splits(split_t* splits, int split_count) {
+    pthread_t threads[split_count];
+    int started = 0;
+    int code = SUCCESS;
+    while (started < split_count) {
+        code = pthread_create(threads + started, DEFAULT_ATTR, compute_split,
+                              (void*)(splits + started));
+        if (code != SUCCESS) {
+            break;
+        }
+        ++started;
+    }
+    int join_code = join_all_threads(threads, started);
+    if (code != SUCCESS || join_code != SUCCESS) {
+        return code != SUCCESS ? code : join_code;
+    }
+
+    merge_data_t merges[split_count];
+    for (int step = 1; step < split_count; step *= 2) {
+        int merge_count = 0;
+        for (int i = 0; i + step < split_count; i += 2 * step) {
+            merges[merge_count].left = splits + i;
+            merges[merge_count].right = splits + i + step;
+            code = pthread_create(threads + merge_count, DEFAULT_ATTR,
+                                  merge_splits, (void*)(merges + merge_count));
+            if (code != SUCCESS) {
+                join_all_threads(threads, merge_count);
+                return code;
+            }
+            ++merge_count;
+        }
+        code = join_all_threads(threads, merge_count);
+        if (code != SUCCESS) {
+            return code;
+        }
+    }
+    return SUCCESS;
+}
+
+/*****************************************************************************
+ * Streamed decimal output.
+ ****************************************************************************/
+
+/*
+ * powers[k] = 10^(OUTPUT_CHUNK_DIGITS * 2^k). Leading digits that are
+ * only padding up to the top power are counted down in skip.
+ */
+typedef struct digit_writer_s {
+    FILE* output;
+    mpz_t* powers;
+    long long skip;
+    char* buffer;
+} digit_writer_t;
+
+static long long chunk_digits(int level) {
+    return (long long)OUTPUT_CHUNK_DIGITS << level;
+}
+
+/*
+ * Function frees memory of value keeping it initialized.
+ */
+static void release_value(mpz_t value) {
+    mpz_set_ui(value, 0);
+    mpz_realloc2(value, 1);
+}
+
+static int write_chunk(digit_writer_t* writer, mpz_t value) {
+    mpz_get_str(writer->buffer, 10, value);
+    size_t length = strlen(writer->buffer);
+    size_t padding = OUTPUT_CHUNK_DIGITS - length;
+
+    long long skip = writer->skip < OUTPUT_CHUNK_DIGITS ?
+        writer->skip : OUTPUT_CHUNK_DIGITS;
+    writer->skip -= skip;
+    for (size_t i = skip; i < padding; ++i) {
+        if (fputc('0', writer->output) == EOF) {
+            return errno;
+        }
+    }
+    size_t offset = (size_t)skip > padding ? skip - padding : 0;
+    if (fwrite(writer->buffer + offset, 1, length - offset, writer->output)
+            != length - offset) {
+        return errno;
+    }
+    return SUCCESS;
+}
+
+/*
+ * Function writes value as exactly chunk_digits(level) digits
+ * with leading zeros. Value is released as soon as its high half
+ * is written.
+ */
+static int write_digits(digit_writer_t* writer, mpz_t value, int level) {
+    if (writer->skip >= chunk_digits(level) && mpz_sgn(value) == 0) {
+        writer->skip -= chunk_digits(level);
+        return SUCCESS;
+    }
+    if (level == 0) {
+        return write_chunk(writer, value);
+    }
+    mpz_t low;
+    mpz_init(low);
+    mpz_tdiv_qr(value, low, value, writer->powers[level - 1]);
+    int code = write_digits(writer, value, level - 1);
+    release_value(value);
+    if (code == SUCCESS) {
+        code = write_digits(writer, low, level - 1);
+    }
+    mpz_clear(low);
+    return code;
+}
+
+/*
+ * Function writes the digit_count lowest digits of value.
+ * Value is released.
+ */
+static int write_fraction(FILE* output, mpz_t value, long long digit_count) {
+    int level = 0;
+    while (chunk_digits(level) < digit_count) {
+        ++level;
+    }
+    digit_writer_t writer;
+    writer.output = output;
+    writer.skip = chunk_digits(level) - digit_count;
+    writer.buffer = (char*)malloc(OUTPUT_CHUNK_DIGITS + 2);
+    writer.powers = (mpz_t*)malloc((level + 1) * sizeof(mpz_t));
+    if (writer.buffer == NULL || writer.powers == NULL) {
+        free(writer.buffer);
+        free(writer.powers);
+        return ENOMEM;
+    }
+    for (int i = 0; i < level; ++i) {
+        mpz_init(writer.powers[i]);
+        if (i == 0) {
+            mpz_ui_pow_ui(writer.powers[i], 10, OUTPUT_CHUNK_DIGITS);
+        } else {
+            mpz_mul(writer.powers[i], writer.powers[i - 1],
+                    writer.powers[i - 1]);
+        }
+    }
+
+    int code = write_digits(&writer, value, level);
+
+    for (int i = 0; i < level; ++i) {
+        mpz_clear(writer.powers[i]);
+    }
+    free(writer.powers);
+    free(writer.buffer);
+    return code;
+}
+
+/*****************************************************************************
+ * Driver.
+ ****************************************************************************/
+
+int chudnovsky_write_digits(long long digit_count, int thread_count,
+        FILE* output) {
+    long long term_count = (long long)(digit_count / DIGITS_PER_TERM) + 2;
+    int split_count = thread_count < term_count ? thread_count : term_count;
+
+    split_t* splits = (split_t*)malloc(split_count * sizeof(split_t));
+    if (splits == NULL) {
+        return ENOMEM;
+    }
+    for (int i = 0; i < split_count; ++i) {
+        splits[i].from = term_count * i / split_count;
+        splits[i].to = term_count * (i + 1) / split_count;
+        splits[i].need_p = i != split_count - 1;
+        splits[i].merged = 0;
+        mpz_inits(splits[i].p, splits[i].q, splits[i].t, NULL);
+    }
+    int code = compute_all_splits(splits, split_count);
+    if (code != SUCCESS) {
+        for (int i = 0; i < split_count; ++i) {
+            if (!splits[i].merged) {
+                mpz_clears(splits[i].p, splits[i].q, splits[i].t, NULL);
+            }
+        }
+        free(splits);
+        return code;
+    }
+
+    /*
+     * pi = 426880 sqrt(10005) Q / T. Scaled by 10^(digits + guard) it is
+     * 426880 isqrt(10005 * 10^(2 (digits + guard))) Q / T.
+     */
+    mpz_t pi, root;
+    mpz_inits(pi, root, NULL);
+    mpz_ui_pow_ui(root, 10, 2 * (digit_count + GUARD_DIGITS));
+    mpz_mul_ui(root, root, SQRT_ARGUMENT);
+    mpz_sqrt(root, root);
+    mpz_mul_ui(pi, splits[0].q, FINAL_FACTOR);
+    mpz_clear(splits[0].q);
+    mpz_mul(pi, pi, root);
+    mpz_tdiv_q(pi, pi, splits[0].t);
+    mpz_clears(splits[0].p, splits[0].t, NULL);
+    free(splits);
+
+    mpz_ui_pow_ui(root, 10, GUARD_DIGITS);
+    mpz_tdiv_q(pi, pi, root);
+    mpz_ui_pow_ui(root, 10, digit_count);
+    mpz_tdiv_r(pi, pi, root);
+    mpz_clear(root);
+
+    if (fputs("3.", output) == EOF) {
+        code = errno;
+    } else {
+        code = write_fraction(output, pi, digit_count);
+    }
+    if (code == SUCCESS && fputc('\n', output) == EOF) {
+        code = errno;
+    }
+    mpz_clear(pi);
+    return code;
+}
@@ -0,0 +1,21 @@
+#ifndef chudnovsky_h
+#define chudnovsky_h
+
+#include <stdio.h>
+
+/*
+ * Function computes digit_count decimal digits of pi after the point
+ * with Chudnovsky binary splitting and writes "3.<digits>\n" to output.
+ *
+ * The term range is split into thread_count contiguous leaves, each
+ * leaf is computed by its own thread and the leaves are merged pairwise
+ * by threads as well. Digits are converted by recursive division by
+ * powers of ten and written in chunks as soon as the leftmost chunk is
+ * known, so the decimal string is never held in memory as a whole.
+ *
+ * Returns SUCCESS or error code.
+ */
+int chudnovsky_write_digits(long long digit_count, int thread_count,
+        FILE* output);
+
+#endif /* chudnovsky_h */
@@ -0,0 +1,150 @@
+#include <pthread.h>
+#include <math.h>
+#include "leibniz.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LEIBNIZ_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Kernels accumulate at most this many terms before the partial sum is
+ * added to the total, so that rounding error does not grow with range size.
+ */
+#define LEIBNIZ_CHUNK_SIZE (1 << 16)
+
+typedef double (*leibniz_kernel_t)(long long from, long long to);
+
+static leibniz_kernel_t selected_kernel;
+static const char* selected_kernel_name;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+/*****************************************************************************
+ * Kernels. Every kernel sums 2/((x + 1)(x + 3)) where x = 4i.
+ ****************************************************************************/
+
+static double leibniz_sum_scalar(long long from, long long to) {
+    double result = 0;
+    for (long long index = from; index < to; ++index) {
+        double x = index * 4.0;
+        result += 2.0 / ((x + 1.0) * (x + 3.0));
+    }
+    return result;
+}
+
+#ifdef LEIBNIZ_X86
+
+/*
+ * Two independent accumulators of two lanes each, so that consecutive
+ * divisions do not wait for each other.
+ */
+__attribute__((target("sse2")))
+static double leibniz_sum_sse2(long long from, long long to) {
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d three = _mm_set1_pd(3.0);
+    const __m128d step = _mm_set1_pd(16.0);
+    __m128d x0 = _mm_set_pd(from * 4.0 + 4.0, from * 4.0);
+    __m128d x1 = _mm_add_pd(x0, _mm_set1_pd(8.0));
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+
+    long long index = from;
+    for ( ; index + 4 <= to; index += 4) {
+        __m128d d0 = _mm_mul_pd(_mm_add_pd(x0, one), _mm_add_pd(x0, three));
+        __m128d d1 = _mm_mul_pd(_mm_add_pd(x1, one), _mm_add_pd(x1, three));
+        acc0 = _mm_add_pd(acc0, _mm_div_pd(two, d0));
+        acc1 = _mm_add_pd(acc1, _mm_div_pd(two, d1));
+        x0 = _mm_add_pd(x0, step);
+        x1 = _mm_add_pd(x1, step);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1] + leibniz_sum_scalar(index, to);
+}
+
+/*
+ * Same as the SSE2 kernel with four lanes per register.
+ * The denominator is computed as x(x + 4) + 3 with a single FMA.
+ */
+__attribute__((target("avx2,fma")))
+static double leibniz_sum_avx2(long long from, long long to) {
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d three = _mm256_set1_pd(3.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d step = _mm256_set1_pd(32.0);
+    __m256d x0 = _mm256_add_pd(_mm256_set1_pd(from * 4.0),
+                               _mm256_set_pd(12.0, 8.0, 4.0, 0.0));
+    __m256d x1 = _mm256_add_pd(x0, _mm256_set1_pd(16.0));
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+
+    long long index = from;
+    for ( ; index + 8 <= to; index += 8) {
+        __m256d d0 = _mm256_fmadd_pd(x0, _mm256_add_pd(x0, four), three);
+        __m256d d1 = _mm256_fmadd_pd(x1, _mm256_add_pd(x1, four), three);
+        acc0 = _mm256_add_pd(acc0, _mm256_div_pd(two, d0));
+        acc1 = _mm256_add_pd(acc1, _mm256_div_pd(two, d1));
+        x0 = _mm256_add_pd(x0, step);
+        x1 = _mm256_add_pd(x1, step);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+        leibniz_sum_scalar(index, to);
+}
+
+#endif /* LEIBNIZ_X86 */
+
+/*****************************************************************************
+ * Runtime kernel selection.
+ ****************************************************************************/
+
+static void select_kernel() {
+    selected_kernel = leibniz_sum_scalar;
+    selected_kernel_name = "scalar";
+#ifdef LEIBNIZ_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        selected_kernel = leibniz_sum_avx2;
+        selected_kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        selected_kernel = leibniz_sum_sse2;
+        selected_kernel_name = "sse2";
+    }
+#endif
+}
+
+void leibniz_block_sum_compensated(long long from, long long to,
+        double* sum, double* compensation) {
+    pthread_once(&kernel_once, select_kernel);
+    double result = 0;
+    double error = 0;
+    for (long long chunk = from; chunk < to; chunk += LEIBNIZ_CHUNK_SIZE) {
+        long long chunk_end = to - chunk > LEIBNIZ_CHUNK_SIZE ?
+            chunk + LEIBNIZ_CHUNK_SIZE : to;
+        double term = selected_kernel(chunk, chunk_end);
+        double total = result + term;
+        if (fabs(result) >= fabs(term)) {
+            error += (result - total) + term;
+        } else {
+            error += (term - total) + result;
+        }
+        result = total;
+    }
+    *sum = result;
+    *compensation = error;
+}
+
+double leibniz_block_sum(long long from, long long to) {
+    double sum, compensation;
+    leibniz_block_sum_compensated(from, to, &sum, &compensation);
+    return sum + compensation;
+}
+
+const char* leibniz_kernel_name() {
+    pthread_once(&kernel_once, select_kernel);
+    return selected_kernel_name;
+}
@@ -0,0 +1,28 @@
+#ifndef leibniz_h
+#define leibniz_h
+
+/*
+ * Function returns sum of Leibniz series terms
+ * 1/(4i + 1) - 1/(4i + 3) for i in [from, to).
+ * Each pair of terms is summed as 2/((4i + 1)(4i + 3)),
+ * so there is a single division per index.
+ * The widest kernel supported by the CPU (AVX2, SSE2 or scalar)
+ * is chosen on the first call.
+ */
+double leibniz_block_sum(long long from, long long to);
+
+/*
+ * Same as leibniz_block_sum(), but chunk sums are added with Neumaier
+ * compensation and the rounding error is returned separately:
+ * the sum of the range is *sum + *compensation.
+ */
+void leibniz_block_sum_compensated(long long from, long long to,
+        double* sum, double* compensation);
+
+/*
+ * Function returns name of the kernel used by leibniz_block_sum():
+ * "avx2", "sse2" or "scalar".
+ */
+const char* leibniz_kernel_name();
+
+#endif /* leibniz_h */
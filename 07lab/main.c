@@ -3,101 +3,689 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <limits.h>
 #include "../utils/util.h"
+#include "../utils/thread_pool.h"
+#include "../utils/telemetry.h"
+#include "../utils/cpu_topology.h"
+#include "../utils/process_farm.h"
+#include "leibniz.h"
+#include "pi_series.h"
+#include "chudnovsky.h"
+#include "series_cache.h"
+
+#define ITER_COUNT 2000000000LL
+#define CORRECTED_PAIR_COUNT 1000LL
+#define MACHIN_TERM_COUNT 24LL
+#define BBP_TERM_COUNT 16LL
+#define CACHE_BLOCK_SIZE (1LL << 24)
+#define TELEMETRY_ITER_COUNT (1LL << 22)
+#define TASKS_PER_PROCESS 8
+#define ENGINE_COUNT (int)(sizeof(ENGINES) / sizeof(ENGINES[0]))
 
-const int ITER_COUNT = 2000000000;
 const int EXPECTED_ARGS_COUNT = 2;
 const int BASE = 0;
+const double PI_REFERENCE = 3.14159265358979323846;
 
 typedef struct threads_data_s {
     int thread_id;
     int thread_count;
-    double result;
+    long long term_count;
+    long long from;
+    long long to;
 } threads_data_t;
 
-threads_data_t* allocate_threads_data(int thread_count) {
-    return (threads_data_t*)malloc(thread_count * sizeof(threads_data_t));
+/*
+ * Data of thread i lives in local memory of worker i, which the worker
+ * has touched first, so it is placed on the worker's NUMA node.
+ * Only the array of pointers is allocated here.
+ */
+threads_data_t** allocate_threads_data(thread_pool_t* pool) {
+    threads_data_t** threads_data = (threads_data_t**)malloc(
+        pool->worker_count * sizeof(threads_data_t*));
+    if (threads_data == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < pool->worker_count; ++i) {
+        threads_data[i] = (threads_data_t*) pool->workers[i].local;
+    }
+    return threads_data;
 }
 
 void free_threads_data(void* ptr) {
     free(ptr);
 }
-void fill_threads_data(threads_data_t* threads_data, int thread_count) {
+
+void fill_thread_data(threads_data_t* thread_data, int thread_id,
+        int thread_count, long long term_count) {
+    thread_data->thread_id = thread_id;
+    thread_data->thread_count = thread_count;
+    thread_data->term_count = term_count;
+    thread_data->from = term_count * thread_id / thread_count;
+    thread_data->to = term_count * (thread_id + 1) / thread_count;
+}
+
+void fill_threads_data(threads_data_t** threads_data, int thread_count,
+        long long term_count) {
     for (int i = 0; i < thread_count; ++i) {
-        threads_data[i].thread_id = i;
-        threads_data[i].thread_count = thread_count;
+        fill_thread_data(threads_data[i], i, thread_count, term_count);
+    }
+}
+
+/*****************************************************************************
+ * Stats segment that workers publish their progress to, if enabled.
+ * Every worker owns the slot with its id.
+ ****************************************************************************/
+
+telemetry_t* global_telemetry = NULL;
+
+void start_telemetry_run(long long term_count) {
+    if (global_telemetry != NULL) {
+        telemetry_start_run(global_telemetry,
+                            global_telemetry->header->thread_count, term_count);
+    }
+}
+
+void publish_progress(pool_worker_t* worker, long long term_count) {
+    if (global_telemetry != NULL) {
+        telemetry_add(global_telemetry, worker->id, term_count);
+    }
+}
+
+void add_compensated(double* sum, double* compensation, double term) {
+    double total = *sum + term;
+    if (fabs(*sum) >= fabs(term)) {
+        *compensation += (*sum - total) + term;
+    } else {
+        *compensation += (term - total) + *sum;
     }
+    *sum = total;
 }
 
+/*****************************************************************************
+ * Task routine functions. Each one adds its contribution to pi
+ * to the result slot of the worker running it. Long ranges are summed
+ * in parts of TELEMETRY_ITER_COUNT terms with progress published
+ * after every part.
+ ****************************************************************************/
 
-void* compute_pi(void *arg) {
+void compute_pi(void *arg, pool_worker_t* worker) {
     threads_data_t *thread_data = (threads_data_t*)arg;
     int id = thread_data->thread_id;
     int num_threads = thread_data->thread_count;
+    long long term_count = thread_data->term_count;
+    long long part_size = num_threads * TELEMETRY_ITER_COUNT;
     double result = 0;
-    for (int index = id; index < ITER_COUNT; index += num_threads) {
-        result += 1.0/(index * 4.0 + 1.0);
-        result -= 1.0/(index * 4.0 + 3.0);
+    for (long long start = id; start < term_count; start += part_size) {
+        long long end = term_count - start > part_size ?
+            start + part_size : term_count;
+        for (long long index = start; index < end; index += num_threads) {
+            result += 1.0/(index * 4.0 + 1.0);
+            result -= 1.0/(index * 4.0 + 3.0);
+        }
+        publish_progress(worker, (end - start + num_threads - 1) / num_threads);
     }
-    thread_data->result = result;
-    pthread_exit(NULL);
+    worker->result += result * 4;
 }
 
+/*
+ * Thread computes contiguous range [from, to) of the series
+ * with the vectorized kernel.
+ */
+void compute_pi_block(void *arg, pool_worker_t* worker) {
+    threads_data_t *thread_data = (threads_data_t*)arg;
+    double sum = 0;
+    double compensation = 0;
+    for (long long from = thread_data->from; from < thread_data->to;
+            from += TELEMETRY_ITER_COUNT) {
+        long long to = thread_data->to - from > TELEMETRY_ITER_COUNT ?
+            from + TELEMETRY_ITER_COUNT : thread_data->to;
+        double part_sum, part_compensation;
+        leibniz_block_sum_compensated(from, to, &part_sum, &part_compensation);
+        add_compensated(&sum, &compensation, part_sum);
+        compensation += part_compensation;
+        publish_progress(worker, to - from);
+    }
+    worker->result += (sum + compensation) * 4;
+}
 
-int start_all_threads(pthread_t* threads, threads_data_t* data, int thread_count) {
-    for (int i = 0; i < thread_count; ++i) {
-        int code = pthread_create(threads + i, DEFAULT_ATTR, compute_pi,
-                                  (void*)(data + i));
-        if (code != 0) {
-            return code;
+void compute_pi_machin(void *arg, pool_worker_t* worker) {
+    threads_data_t *thread_data = (threads_data_t*)arg;
+    worker->result += machin_block_sum(thread_data->from, thread_data->to);
+    publish_progress(worker, thread_data->to - thread_data->from);
+}
+
+void compute_pi_bbp(void *arg, pool_worker_t* worker) {
+    threads_data_t *thread_data = (threads_data_t*)arg;
+    worker->result += bbp_block_sum(thread_data->from, thread_data->to);
+    publish_progress(worker, thread_data->to - thread_data->from);
+}
+
+/*****************************************************************************
+ * Engines: series routine, number of terms to sum and optional correction
+ * added to the gathered sum.
+ ****************************************************************************/
+
+typedef struct pi_engine_s {
+    const char* name;
+    task_routine_t routine;
+    long long term_count;
+    double (*tail_correction)(long long term_count);
+} pi_engine_t;
+
+const pi_engine_t ENGINES[] = {
+    { "strided", compute_pi, ITER_COUNT, NULL },
+    { "block", compute_pi_block, ITER_COUNT, NULL },
+    { "euler", compute_pi_block, CORRECTED_PAIR_COUNT, leibniz_tail_correction },
+    { "machin", compute_pi_machin, MACHIN_TERM_COUNT, NULL },
+    { "bbp", compute_pi_bbp, BBP_TERM_COUNT, NULL },
+};
+
+/*
+ * Function queues one task per block, task i is run by worker i
+ * next to its data. The latch is counted down when a task is finished.
+ */
+void submit_all_tasks(thread_pool_t* pool, threads_data_t** data,
+        int task_count, task_routine_t routine, latch_t* latch) {
+    latch_reset(latch, task_count);
+    for (int i = 0; i < task_count; ++i) {
+        thread_pool_submit_to(pool, i, routine, (void*) data[i], latch);
+    }
+}
+
+double gather_pi_value(thread_pool_t* pool, latch_t* latch) {
+    latch_wait(latch);
+    return thread_pool_gather_results(pool);
+}
+
+/*
+ * Function runs engine over term_count terms on the pool and stores
+ * computed value in pi and elapsed wall time in seconds.
+ */
+void run_engine(const pi_engine_t* engine, long long term_count,
+        thread_pool_t* pool, latch_t* latch, threads_data_t** threads_data,
+        int thread_count, double* pi, double* seconds) {
+    double start_time = get_time_in_seconds();
+    start_telemetry_run(term_count);
+    fill_threads_data(threads_data, thread_count, term_count);
+    submit_all_tasks(pool, threads_data, thread_count, engine->routine, latch);
+    *pi = gather_pi_value(pool, latch);
+    if (engine->tail_correction != NULL) {
+        *pi += engine->tail_correction(term_count);
+    }
+    *seconds = get_time_in_seconds() - start_time;
+}
+
+void print_engine_result(const pi_engine_t* engine, long long term_count,
+        double pi, double seconds) {
+    printf("%-8s terms = %-11lld time = %.6f s  pi = %.15f  error = %.1e\n",
+        engine->name, term_count, seconds, pi, fabs(pi - PI_REFERENCE));
+}
+
+/*****************************************************************************
+ * Multi-process mode: the coordinator splits the series into
+ * TASKS_PER_PROCESS tasks per worker process, so that work of a worker
+ * that dies is small and is given to another worker.
+ ****************************************************************************/
+
+/*
+ * Function runs engine over term_count terms in process_count worker
+ * processes and stores the number of tasks taken from dead workers
+ * in reassigned_count. Returns SUCCESS or error code.
+ */
+int run_engine_in_processes(const pi_engine_t* engine, long long term_count,
+        int process_count, double* pi, double* seconds,
+        int* reassigned_count) {
+    double start_time = get_time_in_seconds();
+    int task_count = process_count * TASKS_PER_PROCESS;
+    threads_data_t* tasks = (threads_data_t*)malloc(
+        task_count * sizeof(threads_data_t));
+    double* results = (double*)malloc(task_count * sizeof(double));
+    if (tasks == NULL || results == NULL) {
+        free(tasks);
+        free(results);
+        return ENOMEM;
+    }
+    for (int i = 0; i < task_count; ++i) {
+        fill_thread_data(tasks + i, i, task_count, term_count);
+    }
+    int code = process_farm_run(process_count, engine->routine, tasks,
+        sizeof(threads_data_t), task_count, results, reassigned_count);
+    if (code == SUCCESS) {
+        *pi = 0;
+        for (int i = 0; i < task_count; ++i) {
+            *pi += results[i];
         }
+        if (engine->tail_correction != NULL) {
+            *pi += engine->tail_correction(term_count);
+        }
+        *seconds = get_time_in_seconds() - start_time;
     }
-    return EXIT_SUCCESS;
+    free(tasks);
+    free(results);
+    return code;
 }
 
+/*****************************************************************************
+ * Cached block engine: the series is split into blocks of CACHE_BLOCK_SIZE
+ * terms, sums of whole blocks are kept in the cache file between runs and
+ * only blocks missing from it are computed. The incomplete last block is
+ * not cached.
+ ****************************************************************************/
 
-int parse_arg_or_exit_if_error(int argc, const char *argv[]) {
-    exit_if_true_with_message(argc < EXPECTED_ARGS_COUNT,
-        "Thread count was expected as a parameter");
+void compute_cached_block(void *arg, pool_worker_t* worker) {
+    cached_block_t* block = (cached_block_t*)arg;
+    leibniz_block_sum_compensated(block->from, block->to, &block->sum,
+                                  &block->compensation);
+    publish_progress(worker, block->to - block->from);
+}
+
+/*
+ * Function adds blocks in index order, so the result does not depend
+ * on which of them were taken from the cache.
+ */
+double sum_cached_blocks(cached_block_t* blocks, long long block_count,
+        cached_block_t* last_block) {
+    double sum = 0;
+    double compensation = 0;
+    for (long long i = 0; i < block_count; ++i) {
+        add_compensated(&sum, &compensation, blocks[i].sum);
+        add_compensated(&sum, &compensation, blocks[i].compensation);
+    }
+    add_compensated(&sum, &compensation, last_block->sum);
+    add_compensated(&sum, &compensation, last_block->compensation);
+    return sum + compensation;
+}
+
+/*
+ * Function runs block engine over term_count terms computing only blocks
+ * missing from cache, and stores the number of computed terms
+ * in computed_count. Returns SUCCESS or error code.
+ */
+int run_cached_engine(const pi_engine_t* engine, long long term_count,
+        series_cache_t* cache, thread_pool_t* pool, latch_t* latch,
+        double* pi, double* seconds, long long* computed_count) {
+    double start_time = get_time_in_seconds();
+    long long block_count = term_count / cache->block_size;
+    int code = series_cache_reserve(cache, block_count);
+    if (code != SUCCESS) {
+        return code;
+    }
+
+    cached_block_t last_block = { block_count * cache->block_size, term_count,
+                                  0, 0 };
+    int task_count = last_block.to > last_block.from ? 1 : 0;
+    for (long long i = 0; i < block_count; ++i) {
+        task_count += series_cache_has_block(cache, i) ? 0 : 1;
+    }
+    latch_reset(latch, task_count);
+    *computed_count = last_block.to - last_block.from;
+    for (long long i = 0; i < block_count; ++i) {
+        *computed_count += series_cache_has_block(cache, i) ?
+            0 : cache->block_size;
+    }
+    start_telemetry_run(*computed_count);
+    for (long long i = 0; i < block_count; ++i) {
+        if (!series_cache_has_block(cache, i)) {
+            cached_block_t* block = cache->blocks + i;
+            block->from = i * cache->block_size;
+            block->to = block->from + cache->block_size;
+            thread_pool_submit(pool, compute_cached_block, (void*)block, latch);
+        }
+    }
+    if (last_block.to > last_block.from) {
+        thread_pool_submit(pool, compute_cached_block, (void*)&last_block, latch);
+    }
+    latch_wait(latch);
+
+    code = series_cache_save(cache);
+    if (code != SUCCESS) {
+        return code;
+    }
+    *pi = sum_cached_blocks(cache->blocks, block_count, &last_block) * 4;
+    if (engine->tail_correction != NULL) {
+        *pi += engine->tail_correction(term_count);
+    }
+    *seconds = get_time_in_seconds() - start_time;
+    return SUCCESS;
+}
+
+
+/*
+ * Function writes digit_count digits of pi computed by Chudnovsky engine
+ * to file output_path and prints wall time and digits per second.
+ */
+int run_chudnovsky(long long digit_count, const char* output_path,
+        int thread_count) {
+    FILE* output = fopen(output_path, "w");
+    if (output == NULL) {
+        log_error("Unable to open output file", errno);
+        return errno;
+    }
+    double start_time = get_time_in_seconds();
+    int code = chudnovsky_write_digits(digit_count, thread_count, output);
+    if (fclose(output) != 0 && code == SUCCESS) {
+        code = errno;
+    }
+    if (code != SUCCESS) {
+        log_error("Unable to compute digits", code);
+        return code;
+    }
+    double seconds = get_time_in_seconds() - start_time;
+    printf("chudnovsky digits = %lld time = %.3f s  digits/s = %.0f\n",
+        digit_count, seconds, digit_count / seconds);
+    return SUCCESS;
+}
+
+
+void print_usage_and_exit() {
+    exit_with_custom_message("Usage: <program_name> "
+        "[-m strided|block|euler|machin|bbp|all] [-r repeat_count] "
+        "[-n term_count] [-c cache_file] [-s stats_name] "
+        "[-a compact|scatter|cpu_list] [-P] "
+        "[-d digit_count -o output_file] <thread_count>", EXIT_FAILURE);
+}
+
+/*
+ * Counts are also accepted in the 2.1e9 form, as long as they are integer.
+ */
+long long parse_count_or_exit_if_error(const char* string_value,
+        const char* message) {
+    char* endptr;
+    errno = 0;
+    double value = strtod(string_value, &endptr);
+    exit_if_error(errno);
+    exit_if_true_with_message(endptr[0] != '\0' || value < 1 ||
+        value > (double)LLONG_MAX || value != (long long)value, (char*) message);
+    return (long long)value;
+}
+
+/*
+ * Function stores in [first, last) the range of ENGINES selected by name.
+ * "all" selects every engine.
+ */
+void parse_engine_or_exit_if_error(const char* name, int* first, int* last) {
+    if (strcmp(name, "all") == 0) {
+        *first = 0;
+        *last = ENGINE_COUNT;
+        return;
+    }
+    for (int i = 0; i < ENGINE_COUNT; ++i) {
+        if (strcmp(name, ENGINES[i].name) == 0) {
+            *first = i;
+            *last = i + 1;
+            return;
+        }
+    }
+    print_usage_and_exit();
+}
+
+typedef struct options_s {
+    int thread_count;
+    int first_engine;
+    int last_engine;
+    int repeat_count;
+    long long term_count;
+    const char* cache_path;
+    const char* stats_name;
+    const char* placement;
+    int use_processes;
+    long long digit_count;
+    const char* output_path;
+} options_t;
+
+int parse_positive_or_exit_if_error(const char* string_value,
+        const char* message) {
     char* endptr;
-    int thread_count = (int)strtol(argv[1], &endptr, BASE);
-    exit_if_error(errno, NO_CLEANUP, NO_ARG);
+    errno = 0;
+    int value = (int)strtol(string_value, &endptr, BASE);
+    exit_if_error(errno);
     exit_if_true_with_message(endptr[0] != '\0', "Invalid input");
-    exit_if_true_with_message(thread_count <= 0,
+    exit_if_true_with_message(value <= 0, (char*) message);
+    return value;
+}
+
+void parse_arg_or_exit_if_error(int argc, char *argv[], options_t* options) {
+    options->first_engine = 0;
+    options->last_engine = 1;
+    options->repeat_count = 1;
+    options->term_count = 0;
+    options->cache_path = NULL;
+    options->stats_name = NULL;
+    options->placement = NULL;
+    options->use_processes = 0;
+    options->digit_count = 0;
+    options->output_path = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "m:r:n:c:s:a:Pd:o:")) != -1) {
+        if (option == 'm') {
+            parse_engine_or_exit_if_error(optarg, &options->first_engine,
+                                          &options->last_engine);
+        } else if (option == 'r') {
+            options->repeat_count = parse_positive_or_exit_if_error(optarg,
+                "Repeat count must be a positive number");
+        } else if (option == 'n') {
+            options->term_count = parse_count_or_exit_if_error(optarg,
+                "Term count must be a positive integer");
+        } else if (option == 'c') {
+            options->cache_path = optarg;
+        } else if (option == 's') {
+            options->stats_name = optarg;
+        } else if (option == 'a') {
+            options->placement = optarg;
+        } else if (option == 'P') {
+            options->use_processes = 1;
+        } else if (option == 'd') {
+            options->digit_count = parse_count_or_exit_if_error(optarg,
+                "Digit count must be a positive integer");
+        } else if (option == 'o') {
+            options->output_path = optarg;
+        } else {
+            print_usage_and_exit();
+        }
+    }
+    if ((options->digit_count == 0) != (options->output_path == NULL)) {
+        print_usage_and_exit();
+    }
+    exit_if_true_with_message(argc - optind < EXPECTED_ARGS_COUNT - 1,
+        "Thread count was expected as a parameter");
+    options->thread_count = parse_positive_or_exit_if_error(argv[optind],
         "Thread count parameter must be a positive number");
-    return thread_count;
 }
 
+/*
+ * Function runs selected engines in worker processes instead of threads,
+ * one process per thread_count. Returns SUCCESS or error code.
+ */
+int run_all_in_processes(options_t* options) {
+    printf("kernel = %s  processes = %d\n", leibniz_kernel_name(),
+        options->thread_count);
+    for (int i = options->first_engine; i < options->last_engine; ++i) {
+        const pi_engine_t* engine = ENGINES + i;
+        long long term_count = options->term_count != 0 ?
+            options->term_count : engine->term_count;
+        for (int run = 0; run < options->repeat_count; ++run) {
+            double pi, seconds;
+            int reassigned_count;
+            int code = run_engine_in_processes(engine, term_count,
+                options->thread_count, &pi, &seconds, &reassigned_count);
+            if (code != SUCCESS) {
+                log_error("Unable to run worker processes", code);
+                return code;
+            }
+            print_engine_result(engine, term_count, pi, seconds);
+            if (reassigned_count != 0) {
+                printf("%-8s reassigned %d tasks of dead workers\n", "",
+                    reassigned_count);
+            }
+        }
+    }
+    return SUCCESS;
+}
 
-int main(int argc, const char *argv[]) {
-    /* Reading thread_count passed as command line argument */
-    int thread_count = parse_arg_or_exit_if_error(argc, argv);
+void print_placement(int* cpus, int thread_count) {
+    printf("cpus =");
+    for (int i = 0; i < thread_count; ++i) {
+        printf(" %d", cpus[i]);
+    }
+    printf("\n");
+}
 
-    /* Allocating memory for data to pass to each thread routine
-     * and initializing this data */
-    threads_data_t *threads_data = allocate_threads_data(thread_count);
-    exit_if_error(threads_data == NULL ? ENOMEM : 0, NO_CLEANUP, NO_ARG);
-    fill_threads_data(threads_data, thread_count);
+/*****************************************************************************
+ * Cleanup data and cleanup routine.
+ ****************************************************************************/
 
-    /* Creating an array of thread descriptors,
-     * starting all threads and checking if
-     * there was an error while creating */
-    pthread_t threads[thread_count];
-    int code = start_all_threads(threads, threads_data, thread_count);
-    exit_if_error(code, free_threads_data, threads_data);
+typedef struct cleanup_data_s {
+    telemetry_t* telemetry;
+    series_cache_t* cache;
+    thread_pool_t* pool;
+    latch_t* latch;
+    threads_data_t** threads_data;
+} cleanup_data_t;
 
-    /* Joining threads and sum up their results */
-    double pi = 0;
-    for (int i = 0; i < thread_count; ++i) {
-        code = pthread_join(threads[i], NULL);
-        exit_if_error(code, free_threads_data, threads_data);
-        pi += threads_data[i].result * 4;
+void cleanup_routine(void* arg) {
+    cleanup_data_t* cleanup_data = (cleanup_data_t*) arg;
+    if (cleanup_data->pool != NULL) {
+        thread_pool_destroy(cleanup_data->pool);
     }
+    if (cleanup_data->latch != NULL) {
+        latch_destroy(cleanup_data->latch);
+    }
+    free_threads_data(cleanup_data->threads_data);
+    if (cleanup_data->cache != NULL) {
+        series_cache_close(cleanup_data->cache);
+    }
+    if (cleanup_data->telemetry != NULL) {
+        telemetry_destroy(cleanup_data->telemetry);
+    }
+}
+
+/*
+ * Function runs engine once and prints the result. Block engine uses
+ * the series cache if there is one. Returns SUCCESS or error code.
+ */
+int run_and_print_engine(const pi_engine_t* engine, options_t* options,
+        series_cache_t* cache, thread_pool_t* pool, latch_t* latch,
+        threads_data_t** threads_data) {
+    long long term_count = options->term_count != 0 ?
+        options->term_count : engine->term_count;
+    double pi, seconds;
+    if (cache == NULL || engine->routine != compute_pi_block) {
+        run_engine(engine, term_count, pool, latch, threads_data,
+                   options->thread_count, &pi, &seconds);
+        print_engine_result(engine, term_count, pi, seconds);
+        return SUCCESS;
+    }
+    long long computed_count;
+    int code = run_cached_engine(engine, term_count, cache, pool, latch, &pi,
+                                 &seconds, &computed_count);
+    if (code != SUCCESS) {
+        log_error("Unable to update series cache", code);
+        return code;
+    }
+    print_engine_result(engine, term_count, pi, seconds);
+    printf("%-8s computed = %lld terms, %lld taken from cache\n", "",
+        computed_count, term_count - computed_count);
+    return SUCCESS;
+}
 
-    /* Printing results of each thread and total */
-    printf("pi = %.15f\n", pi);
 
-    /* Freeing allocated memory and terminating the process */
-    free_threads_data(threads_data);
-    exit(EXIT_SUCCESS);
+int main(int argc, char *argv[]) {
+    /* Reading thread_count and engines passed
+     * as command line arguments */
+    options_t options;
+    parse_arg_or_exit_if_error(argc, argv, &options);
+    int thread_count = options.thread_count;
+
+    /* Arbitrary precision digits are written to file instead */
+    if (options.digit_count != 0) {
+        int code = run_chudnovsky(options.digit_count, options.output_path,
+                                  thread_count);
+        exit(code == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    /* Worker processes are forked before any thread is started */
+    if (options.use_processes) {
+        int code = run_all_in_processes(&options);
+        exit(code == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    /* Starting workers once for all runs, pinned if placement is given,
+     * and taking data to pass to each task from their local memory */
+    cleanup_data_t cleanup_data = { NULL, NULL, NULL, NULL, NULL };
+    int cpus[thread_count];
+    int code = SUCCESS;
+    if (options.placement != NULL) {
+        code = cpu_place_threads(options.placement, thread_count, cpus);
+        if (code != SUCCESS) {
+            log_error("Unable to place threads", code);
+            exit(EXIT_FAILURE);
+        }
+        print_placement(cpus, thread_count);
+    }
+
+    latch_t latch;
+    code = latch_init(&latch, 0);
+    if (code != SUCCESS) {
+        log_error("Unable to initialize latch", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+    }
+    cleanup_data.latch = &latch;
+
+    thread_pool_t pool;
+    code = thread_pool_init_pinned(&pool, thread_count,
+        options.placement != NULL ? cpus : NULL, sizeof(threads_data_t));
+    if (code != SUCCESS) {
+        log_error("Unable to start threads", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+    }
+    cleanup_data.pool = &pool;
+
+    threads_data_t **threads_data = allocate_threads_data(&pool);
+    if (threads_data == NULL) {
+        log_error("Unable to allocate threads data", ENOMEM);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+    }
+    cleanup_data.threads_data = threads_data;
+
+    series_cache_t cache;
+    if (options.cache_path != NULL) {
+        code = series_cache_open(&cache, options.cache_path, CACHE_BLOCK_SIZE,
+                                 leibniz_kernel_name());
+        if (code != SUCCESS) {
+            log_error("Unable to open series cache", code);
+            exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+        }
+        cleanup_data.cache = &cache;
+    }
+
+    telemetry_t telemetry;
+    if (options.stats_name != NULL) {
+        code = telemetry_create(&telemetry, options.stats_name, thread_count);
+        if (code != SUCCESS) {
+            log_error("Unable to create stats segment", code);
+            exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+        }
+        cleanup_data.telemetry = &telemetry;
+        global_telemetry = &telemetry;
+    }
+
+    /* Running selected engines repeat_count times each on the same
+     * workers and printing wall time and error of each run */
+    printf("kernel = %s\n", leibniz_kernel_name());
+    for (int i = options.first_engine; i < options.last_engine; ++i) {
+        for (int run = 0; run < options.repeat_count; ++run) {
+            code = run_and_print_engine(ENGINES + i, &options,
+                cleanup_data.cache, &pool, &latch, threads_data);
+            if (code != SUCCESS) {
+                exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+            }
+        }
+    }
+
+    /* Stopping workers, freeing allocated memory and terminating
+     * the process */
+    exit_with_cleanup(EXIT_SUCCESS, cleanup_routine, &cleanup_data);
 }
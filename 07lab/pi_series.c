@@ -0,0 +1,39 @@
+#include <math.h>
+#include "pi_series.h"
+
+#define EULER_NUMBER_COUNT 3
+
+static const double EULER_NUMBERS[EULER_NUMBER_COUNT] = { 1.0, -1.0, 5.0 };
+
+double bbp_block_sum(long long from, long long to) {
+    double result = 0;
+    for (long long k = from; k < to; ++k) {
+        double x = k * 8.0;
+        double term = 4.0 / (x + 1.0) - 2.0 / (x + 4.0) -
+            1.0 / (x + 5.0) - 1.0 / (x + 6.0);
+        result += ldexp(term, (int)(-4 * k));
+    }
+    return result;
+}
+
+double machin_block_sum(long long from, long long to) {
+    double result = 0;
+    for (long long k = from; k < to; ++k) {
+        double power = 2.0 * k + 1.0;
+        double term = 16.0 * pow(5.0, -power) - 4.0 * pow(239.0, -power);
+        result += (k % 2 == 0 ? term : -term) / power;
+    }
+    return result;
+}
+
+double leibniz_tail_correction(long long pair_count) {
+    double n = pair_count * 4.0;
+    double n_squared = n * n;
+    double power = n;
+    double result = 0;
+    for (int m = 0; m < EULER_NUMBER_COUNT; ++m) {
+        result += EULER_NUMBERS[m] / power;
+        power *= n_squared;
+    }
+    return 2 * result;
+}
@@ -0,0 +1,34 @@
+#ifndef pi_series_h
+#define pi_series_h
+
+/*
+ * Faster converging companions of the Leibniz series.
+ * Every block sum function returns the contribution of terms
+ * with indices in [from, to) to pi itself (not to pi / 4),
+ * so partial sums of any contiguous split add up to pi.
+ */
+
+/*
+ * Bailey-Borwein-Plouffe formula:
+ * pi = sum 16^-k (4/(8k+1) - 2/(8k+4) - 1/(8k+5) - 1/(8k+6)).
+ * Gains 1.2 decimal digits per term.
+ */
+double bbp_block_sum(long long from, long long to);
+
+/*
+ * Machin formula pi = 16 arctan(1/5) - 4 arctan(1/239) with both
+ * arctangent series merged term by term.
+ * Gains 1.4 decimal digits per term.
+ */
+double machin_block_sum(long long from, long long to);
+
+/*
+ * Function returns the Euler-Maclaurin tail of the Leibniz series:
+ * pi - 4 * leibniz_block_sum(0, pair_count).
+ * The tail is the asymptotic series 2 * sum E(2m) / N^(2m+1) where
+ * E are Euler numbers and N = 4 * pair_count. Three terms of it give
+ * full double precision for pair_count of about a thousand.
+ */
+double leibniz_tail_correction(long long pair_count);
+
+#endif /* pi_series_h */
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../utils/util.h"
+#include "series_cache.h"
+
+#define CACHE_MAGIC "PI07SC01"
+#define CACHE_MODE 0644
+#define KERNEL_NAME_SIZE 16
+
+typedef struct cache_header_s {
+    char magic[8];
+    char kernel_name[KERNEL_NAME_SIZE];
+    long long block_size;
+    long long block_count;
+} cache_header_t;
+
+static void fill_header(cache_header_t* header, long long block_size,
+        const char* kernel_name) {
+    memset(header, 0, sizeof(cache_header_t));
+    memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+    strncpy(header->kernel_name, kernel_name, KERNEL_NAME_SIZE - 1);
+    header->block_size = block_size;
+}
+
+/*
+ * Function reads blocks stored in the file. A file that is empty or
+ * does not match expected header is not an error: the cache is empty.
+ */
+static int read_blocks(series_cache_t* cache, cache_header_t* expected) {
+    cache_header_t header;
+    ssize_t size = pread(cache->fd, &header, sizeof(header), 0);
+    if (size < 0) {
+        return errno;
+    }
+    if (size != sizeof(header) || header.block_count <= 0 ||
+            memcmp(header.magic, expected->magic, sizeof(header.magic)) != 0 ||
+            memcmp(header.kernel_name, expected->kernel_name,
+                   KERNEL_NAME_SIZE) != 0 ||
+            header.block_size != expected->block_size) {
+        return SUCCESS;
+    }
+
+    int code = series_cache_reserve(cache, header.block_count);
+    if (code != SUCCESS) {
+        return code;
+    }
+    size_t blocks_size = header.block_count * sizeof(cached_block_t);
+    size = pread(cache->fd, cache->blocks, blocks_size, sizeof(header));
+    if (size < 0) {
+        return errno;
+    }
+    /* Blocks that were not read completely or do not cover
+     * their own range are dropped */
+    for (long long i = 0; i < cache->block_count; ++i) {
+        if ((i + 1) * sizeof(cached_block_t) > (size_t)size ||
+                !series_cache_has_block(cache, i)) {
+            memset(cache->blocks + i, 0, sizeof(cached_block_t));
+        }
+    }
+    return SUCCESS;
+}
+
+int series_cache_open(series_cache_t* cache, const char* path,
+        long long block_size, const char* kernel_name) {
+    cache->block_size = block_size;
+    cache->block_count = 0;
+    cache->blocks = NULL;
+    cache->fd = open(path, O_RDWR | O_CREAT, CACHE_MODE);
+    if (cache->fd < 0) {
+        return errno;
+    }
+    cache_header_t header;
+    fill_header(&header, block_size, kernel_name);
+    int code = read_blocks(cache, &header);
+    if (code == SUCCESS) {
+        header.block_count = cache->block_count;
+        if (pwrite(cache->fd, &header, sizeof(header), 0) != sizeof(header)) {
+            code = errno;
+        }
+    }
+    if (code != SUCCESS) {
+        series_cache_close(cache);
+    }
+    return code;
+}
+
+int series_cache_reserve(series_cache_t* cache, long long block_count) {
+    if (block_count <= cache->block_count) {
+        return SUCCESS;
+    }
+    cached_block_t* blocks = (cached_block_t*)realloc(cache->blocks,
+        block_count * sizeof(cached_block_t));
+    if (blocks == NULL) {
+        return ENOMEM;
+    }
+    memset(blocks + cache->block_count, 0,
+           (block_count - cache->block_count) * sizeof(cached_block_t));
+    cache->blocks = blocks;
+    cache->block_count = block_count;
+    return SUCCESS;
+}
+
+int series_cache_has_block(series_cache_t* cache, long long index) {
+    cached_block_t* block = cache->blocks + index;
+    return block->from == index * cache->block_size &&
+        block->to == block->from + cache->block_size;
+}
+
+int series_cache_save(series_cache_t* cache) {
+    size_t blocks_size = cache->block_count * sizeof(cached_block_t);
+    if (pwrite(cache->fd, cache->blocks, blocks_size, sizeof(cache_header_t))
+            != (ssize_t)blocks_size) {
+        return errno;
+    }
+    /* Block count is updated after the blocks, so that the header
+     * never refers to blocks that are not written yet */
+    long long block_count = cache->block_count;
+    if (pwrite(cache->fd, &block_count, sizeof(block_count),
+               offsetof(cache_header_t, block_count)) != sizeof(block_count)) {
+        return errno;
+    }
+    return SUCCESS;
+}
+
+void series_cache_close(series_cache_t* cache) {
+    close(cache->fd);
+    free(cache->blocks);
+    cache->blocks = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef series_cache_h
+#define series_cache_h
+
+/*
+ * Compensated sum of the series over term range [from, to):
+ * the value is sum + compensation. A block with to == from
+ * was not computed yet.
+ */
+typedef struct cached_block_s {
+    long long from;
+    long long to;
+    double sum;
+    double compensation;
+} cached_block_t;
+
+/*
+ * Cache of series block sums kept in a file. Block i covers terms
+ * [i * block_size, (i + 1) * block_size). Sums depend on the kernel
+ * they were computed with, so a file written with another kernel or
+ * block size is treated as empty.
+ */
+typedef struct series_cache_s {
+    int fd;
+    long long block_size;
+    long long block_count;
+    cached_block_t* blocks;
+} series_cache_t;
+
+/*
+ * Function opens or creates cache file at path and reads all blocks
+ * computed so far. Returns SUCCESS or error code.
+ */
+int series_cache_open(series_cache_t* cache, const char* path,
+        long long block_size, const char* kernel_name);
+
+/*
+ * Function makes room for block_count blocks. New blocks are empty.
+ * Returns SUCCESS or error code.
+ */
+int series_cache_reserve(series_cache_t* cache, long long block_count);
+
+int series_cache_has_block(series_cache_t* cache, long long index);
+
+/*
+ * Function writes all computed blocks to the file.
+ * Returns SUCCESS or error code.
+ */
+int series_cache_save(series_cache_t* cache);
+
+void series_cache_close(series_cache_t* cache);
+
+#endif /* series_cache_h */
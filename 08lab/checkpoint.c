@@ -0,0 +1,83 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC "PI08CKP2"
+#define CHECKPOINT_MODE 0644
+
+static int read_header(int fd, checkpoint_header_t* header) {
+    ssize_t size = pread(fd, header, sizeof(checkpoint_header_t), 0);
+    if (size < 0) {
+        return errno;
+    }
+    if (size != sizeof(checkpoint_header_t) ||
+            memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+            (header->active_state != 0 && header->active_state != 1)) {
+        return EINVAL;
+    }
+    return SUCCESS;
+}
+
+int checkpoint_open(checkpoint_t* checkpoint, const char* path, int resume,
+        size_t record_size, int record_count) {
+    int flags = resume ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC;
+    checkpoint->fd = open(path, flags, CHECKPOINT_MODE);
+    if (checkpoint->fd < 0) {
+        return errno;
+    }
+
+    checkpoint_header_t header;
+    memset(&header, 0, sizeof(header));
+    int code = resume ? read_header(checkpoint->fd, &header) : SUCCESS;
+    checkpoint->size = sizeof(checkpoint_header_t) + record_size * record_count;
+    if (code == SUCCESS && ftruncate(checkpoint->fd, checkpoint->size) != 0) {
+        code = errno;
+    }
+    if (code != SUCCESS) {
+        close(checkpoint->fd);
+        return code;
+    }
+
+    void* address = mmap(NULL, checkpoint->size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, checkpoint->fd, 0);
+    if (address == MAP_FAILED) {
+        code = errno;
+        close(checkpoint->fd);
+        return code;
+    }
+    checkpoint->header = (checkpoint_header_t*) address;
+    checkpoint->records = (char*) address + sizeof(checkpoint_header_t);
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.record_count = record_count;
+    *checkpoint->header = header;
+    memset(checkpoint->records, 0, record_size * record_count);
+    return SUCCESS;
+}
+
+checkpoint_state_t checkpoint_committed_state(checkpoint_t* checkpoint) {
+    checkpoint_header_t* header = checkpoint->header;
+    return header->states[header->active_state];
+}
+
+int checkpoint_commit(checkpoint_t* checkpoint, checkpoint_state_t state) {
+    checkpoint_header_t* header = checkpoint->header;
+    int inactive_state = 1 - header->active_state;
+    header->states[inactive_state] = state;
+    if (msync(header, checkpoint->size, MS_SYNC) != 0) {
+        return errno;
+    }
+    header->active_state = inactive_state;
+    if (msync(header, sizeof(checkpoint_header_t), MS_SYNC) != 0) {
+        return errno;
+    }
+    return SUCCESS;
+}
+
+void checkpoint_close(checkpoint_t* checkpoint) {
+    munmap(checkpoint->header, checkpoint->size);
+    close(checkpoint->fd);
+}
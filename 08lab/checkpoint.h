@@ -0,0 +1,65 @@
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include <stddef.h>
+#include "../utils/util.h"
+
+/*
+ * Summed prefix of the series: result is the sum of terms with indices
+ * in [0, iter_count).
+ */
+typedef struct checkpoint_state_s {
+    long long iter_count;
+    double result;
+} checkpoint_state_t;
+
+#define CHECKPOINT_SERIES_NAME_SIZE 16
+
+/*
+ * Header of the checkpoint file. The committed state is double-buffered:
+ * a commit writes the inactive copy, syncs it and only then switches
+ * active_state, so the file always holds a complete state.
+ * The header is followed by record_count records of record_size bytes
+ * that mirror per-thread data of the running computation.
+ */
+typedef struct checkpoint_header_s {
+    char magic[8];
+    char series_name[CHECKPOINT_SERIES_NAME_SIZE];
+    long long iteration_limit;
+    long long chunk_size;
+    int record_count;
+    int active_state;
+    checkpoint_state_t states[2];
+} __attribute__((aligned(CACHE_LINE_SIZE))) checkpoint_header_t;
+
+typedef struct checkpoint_s {
+    int fd;
+    size_t size;
+    checkpoint_header_t* header;
+    void* records;
+} checkpoint_t;
+
+/*
+ * Function maps checkpoint file at path with room for record_count
+ * records. If resume is zero the file is created or truncated and the
+ * committed state is empty; otherwise the file must be an existing
+ * checkpoint and its committed state and parameters are kept.
+ * Returns SUCCESS or error code.
+ */
+int checkpoint_open(checkpoint_t* checkpoint, const char* path, int resume,
+        size_t record_size, int record_count);
+
+/*
+ * Function returns the last committed state.
+ */
+checkpoint_state_t checkpoint_committed_state(checkpoint_t* checkpoint);
+
+/*
+ * Function writes state and records to disk and makes state
+ * the committed one. Returns SUCCESS or error code.
+ */
+int checkpoint_commit(checkpoint_t* checkpoint, checkpoint_state_t state);
+
+void checkpoint_close(checkpoint_t* checkpoint);
+
+#endif /* checkpoint_h */
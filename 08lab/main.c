@@ -1,74 +1,190 @@
 #include <stdio.h>
+#include <math.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
-#include <limits.h>
+#include <getopt.h>
+#include <unistd.h>
 #include "../utils/util.h"
+#include "../utils/thread_pool.h"
+#include "../utils/chunk_scheduler.h"
+#include "../utils/telemetry.h"
+#include "../utils/cpu_topology.h"
+#include "checkpoint.h"
+#include "series.h"
+#include "service.h"
 
 const int ITER_COUNT = 2e7;
-const int MIN_ITER_COUNT = 1e6;
-const int ARGS_REQUIRED = 2;
+const long long CHUNK_ITER_COUNT = 1e6;
+/* 4 * index + 3 stays exact in double up to 2^53 */
+const long long MAX_ITER_LIMIT = 1LL << 50;
+const double DEFAULT_CHECKPOINT_INTERVAL = 10;
+const char* DEFAULT_SERIES = "pi";
+const int MIN_ARGS_COUNT = 1;
+const int MAX_ARGS_COUNT = 3;
 const int BASE = 0;
 
-pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_barrier_t global_barrier;
+chunk_scheduler_t global_scheduler;
+/* Summed series and its kernel chosen for the CPU */
+const series_t* global_series;
+series_kernel_t global_kernel;
+/* Stats segment for the telemetry reader, NULL if not requested */
+telemetry_t* global_telemetry = NULL;
+/* Daemon stopped on SIGINT, NULL unless serving */
+service_t* global_service = NULL;
 
 /*****************************************************************************
- * Program global state functions.
+ * Program global state functions. The state is set from the signal
+ * handler and polled by workers, so it is accessed atomically.
+ * CHECKPOINTING and RESIZING make workers finish like STOPPED does,
+ * but the run is continued after the checkpoint is written or the
+ * workers are added or removed.
  ****************************************************************************/
 
-typedef enum { RUNNING, STOPPED } program_state_t;
+typedef enum { RUNNING, CHECKPOINTING, RESIZING, STOPPED } program_state_t;
 program_state_t global_state = RUNNING;
+double global_stop_time;
 
 void set_global_state(program_state_t state) {
-    global_state = state;
+    __atomic_store_n(&global_state, state, __ATOMIC_RELEASE);
+}
+
+program_state_t get_global_state() {
+    return __atomic_load_n(&global_state, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Function changes state from expected to desired unless somebody
+ * has changed it already. Returns SUCCESS or FAILURE.
+ */
+int change_global_state(program_state_t expected, program_state_t desired) {
+    return __atomic_compare_exchange_n(&global_state, &expected, desired, 0,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ? SUCCESS : FAILURE;
+}
+
+/*
+ * Function sets RUNNING again after workers have finished for
+ * a checkpoint or a resize. Returns FAILURE if the run was stopped.
+ */
+int resume_running() {
+    program_state_t state = get_global_state();
+    while (state != STOPPED) {
+        if (change_global_state(state, RUNNING) == SUCCESS) {
+            return SUCCESS;
+        }
+        state = get_global_state();
+    }
+    return FAILURE;
 }
 
 /*****************************************************************************
- * Global data. Setter and getter are critical sections.
+ * Global data. Setter and getter are lock-free.
  ****************************************************************************/
 
-int global_max_iter;
+/*
+ * End of the iteration prefix that is summed up after stop.
+ */
+long long global_max_iter;
 
-void set_global_max_iter_if_greater(int iter_count) {
-    pthread_mutex_lock(&global_mutex);
-    if (iter_count > global_max_iter) {
-        global_max_iter = iter_count;
+void set_global_max_iter_if_greater(long long iter_count) {
+    long long current = __atomic_load_n(&global_max_iter, __ATOMIC_RELAXED);
+    while (iter_count > current &&
+            !__atomic_compare_exchange_n(&global_max_iter, &current, iter_count,
+                1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
     }
-    pthread_mutex_unlock(&global_mutex);
 }
 
-int get_global_max_iter() {
-    pthread_mutex_lock(&global_mutex);
-    int max_iter = global_max_iter;
-    pthread_mutex_unlock(&global_mutex);
-    return max_iter;
+long long get_global_max_iter() {
+    return __atomic_load_n(&global_max_iter, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Number of workers requested with SIGUSR1 and SIGUSR2, it is kept
+ * in [1, global_max_thread_count].
+ */
+int global_max_thread_count;
+int global_target_thread_count;
+
+/*
+ * Function moves the target worker count by delta unless it would
+ * leave the allowed range. Returns SUCCESS or FAILURE.
+ */
+int change_target_thread_count(int delta) {
+    int current = __atomic_load_n(&global_target_thread_count, __ATOMIC_RELAXED);
+    int desired;
+    do {
+        desired = current + delta;
+        if (desired < 1 || desired > global_max_thread_count) {
+            return FAILURE;
+        }
+    } while (!__atomic_compare_exchange_n(&global_target_thread_count,
+                &current, desired, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return SUCCESS;
+}
+
+int get_target_thread_count() {
+    return __atomic_load_n(&global_target_thread_count, __ATOMIC_ACQUIRE);
 }
 
 /*****************************************************************************
  * Threads data type: constructor, setter and destructor.
  ****************************************************************************/
 
+/*
+ * iter_count is the progress counter of the thread: number of iterations
+ * it has summed in the current run, result is their sum. Only the owner
+ * writes them. Workload of thread i lives in local memory of worker i,
+ * which is on the worker's NUMA node. With a checkpoint file workloads
+ * are records mapped from the file instead, so both are mirrored there
+ * while the run goes on.
+ */
 typedef struct thread_workload_s {
     int thread_id;
     int thread_count;
+    long long iter_count;
     double result;
-} thread_workload_t;
+} __attribute__((aligned(CACHE_LINE_SIZE))) thread_workload_t;
+
+/*
+ * Function points workloads of running workers to checkpoint records
+ * if there are any, otherwise to local memory of workers.
+ */
+void point_threads_workload(thread_workload_t** threads_workload,
+        thread_pool_t* pool, thread_workload_t* records) {
+    for (int i = 0; i < pool->worker_count; ++i) {
+        threads_workload[i] = records != NULL ?
+            records + i : (thread_workload_t*) pool->workers[i].local;
+    }
+}
 
-thread_workload_t* allocate_threads_workload(int thread_count) {
-    return (thread_workload_t*)malloc(thread_count * sizeof(thread_workload_t));
+/*
+ * Function allocates array of pointers to workloads of as many workers
+ * as the pool may grow to.
+ */
+thread_workload_t** allocate_threads_workload(thread_pool_t* pool,
+        thread_workload_t* records) {
+    thread_workload_t** threads_workload = (thread_workload_t**)malloc(
+        pool->max_worker_count * sizeof(thread_workload_t*));
+    if (threads_workload == NULL) {
+        return NULL;
+    }
+    point_threads_workload(threads_workload, pool, records);
+    return threads_workload;
 }
 
 void free_threads_workload(void* ptr) {
     free(ptr);
 }
 
-void fill_threads_workload(thread_workload_t* threads_workload, int thread_count) {
+void fill_threads_workload(thread_workload_t** threads_workload,
+        int thread_count) {
     for (int i = 0; i < thread_count; ++i) {
-        threads_workload[i].thread_id = i;
-        threads_workload[i].thread_count = thread_count;
+        threads_workload[i]->thread_id = i;
+        threads_workload[i]->thread_count = thread_count;
+        threads_workload[i]->iter_count = 0;
+        threads_workload[i]->result = 0;
     }
 }
 
@@ -76,117 +192,280 @@ void fill_threads_workload(thread_workload_t* threads_workload, int thread_count
  * Threads routine functions.
  ****************************************************************************/
 
-double finish_computing_pi(int iter_count, thread_workload_t* thread_workload) {
-    set_global_max_iter_if_greater(iter_count);
-    pthread_barrier_wait(&global_barrier);
+double compute_chunk(chunk_t chunk, thread_workload_t* thread_workload) {
+    double result = global_kernel(chunk.from, chunk.to);
+    thread_workload->result += result;
+    __atomic_store_n(&thread_workload->iter_count,
+        thread_workload->iter_count + (chunk.to - chunk.from), __ATOMIC_RELAXED);
+    if (global_telemetry != NULL) {
+        telemetry_add(global_telemetry, thread_workload->thread_id,
+                      chunk.to - chunk.from);
+    }
+    return result;
+}
+
+/*
+ * After stop no new chunks are handed out. Every chunk claimed before
+ * that either waits in a deque or is being summed by the thread that
+ * took it, so threads drain their own deques, steal from the others and
+ * leave as soon as nothing is left, without waiting for each other.
+ * When the last thread has published its claim, global_max_iter is the
+ * end of the summed range [first_iteration, global_max_iter).
+ */
+double finish_computing_pi(thread_workload_t* thread_workload) {
     int id = thread_workload->thread_id;
-    int num_threads = thread_workload->thread_count;
-    int index = id + iter_count * num_threads;
+    chunk_scheduler_stop(&global_scheduler);
+    set_global_max_iter_if_greater(
+        chunk_scheduler_claimed_end(&global_scheduler, id));
+
     double result = 0;
-    double local_max_iter = get_global_max_iter();
-    for ( ;iter_count < local_max_iter; ++iter_count) {
-        result += 1.0/(index * 4.0 + 1.0);
-        result -= 1.0/(index * 4.0 + 3.0);
-        index += num_threads;
+    chunk_t chunk;
+    while (chunk_scheduler_next(&global_scheduler, id, &chunk) == SUCCESS) {
+        result += compute_chunk(chunk, thread_workload);
     }
-
     return result;
 }
 
-void* compute_pi(void *arg) {
+/*
+ * Task adds its part of the series to the result slot of the worker.
+ * Stop is checked between chunks.
+ */
+void compute_pi(void *arg, pool_worker_t* worker) {
     thread_workload_t *thread_workload = (thread_workload_t*)arg;
     int id = thread_workload->thread_id;
-    int num_threads = thread_workload->thread_count;
-    const int MAX_ITER_COUNT = INT_MAX / num_threads;
 
-    int iter_count = 0;
     double result = 0;
-
-    for (int index = id; ; index += num_threads) {
-        ++iter_count;
-
-        if ((global_state == STOPPED && iter_count % MIN_ITER_COUNT == 0) ||
-                (iter_count == MAX_ITER_COUNT)) {
-            result += finish_computing_pi(iter_count, thread_workload);
-            thread_workload->result = result;
-            pthread_exit(arg);
-        }
-
-        result += 1.0/(index * 4.0 + 1.0);
-        result -= 1.0/(index * 4.0 + 3.0);
-
+    chunk_t chunk;
+    while (get_global_state() == RUNNING &&
+            chunk_scheduler_next(&global_scheduler, id, &chunk) == SUCCESS) {
+        result += compute_chunk(chunk, thread_workload);
     }
+    result += finish_computing_pi(thread_workload);
+    worker->result += result;
 }
 
 /*****************************************************************************
  * Util functions.
  ****************************************************************************/
 
- void handle_signal(int signal_number) {
-     if (signal_number == SIGINT) {
-         set_global_state(STOPPED);
-     }
- }
+/*
+ * clock_gettime() is async-signal-safe, so the handler can timestamp
+ * the first stop request itself.
+ */
+void handle_signal(int signal_number) {
+    if (signal_number == SIGINT && get_global_state() != STOPPED) {
+        global_stop_time = get_time_in_seconds();
+        set_global_state(STOPPED);
+    }
+    if (signal_number == SIGINT && global_service != NULL) {
+        service_stop(global_service);
+    }
+}
+
+/*
+ * SIGUSR1 adds a worker and SIGUSR2 removes one. The handler only moves
+ * the target count and makes workers finish the current run, the pool
+ * is resized by the main thread before the run goes on.
+ */
+void handle_resize_signal(int signal_number) {
+    int delta = signal_number == SIGUSR1 ? 1 : -1;
+    if (change_target_thread_count(delta) == SUCCESS) {
+        change_global_state(RUNNING, RESIZING);
+    }
+}
 
 int set_signal_handler() {
     errno = 0;
-    if (signal(SIGINT, handle_signal) == SIG_ERR) {
+    if (signal(SIGINT, handle_signal) == SIG_ERR ||
+            signal(SIGUSR1, handle_resize_signal) == SIG_ERR ||
+            signal(SIGUSR2, handle_resize_signal) == SIG_ERR) {
         return errno;
     }
     return SUCCESS;
 }
 
 void print_usage() {
-    printf("Usage: <program_name> <thread_count>\n");
+    printf("Usage: <program_name> [--checkpoint <file> [--resume] "
+        "[--interval <seconds>]] [--stats <name>] "
+        "[--affinity compact|scatter|<cpu_list>] "
+        "[--series pi|ln2|zeta2|catalan] [--max-threads <count>] "
+        "<thread_count> [repeat_count] [iteration_limit]\n"
+        "       <program_name> --serve <socket_path> "
+        "[--affinity compact|scatter|<cpu_list>] <thread_count>\n");
 }
 
-int parse_thread_count(const char* string_value, int* result) {
+int parse_positive_number(const char* string_value, int* result) {
     char* end_pointer;
     errno = 0;
-    int thread_count = strtol(string_value, &end_pointer, BASE);
+    int value = strtol(string_value, &end_pointer, BASE);
     if (errno == EINVAL || errno == ERANGE) {
         return EINVAL;
     }
-    if (*end_pointer != '\0') {
+    if (*end_pointer != '\0' || value <= 0) {
         return EINVAL;
     }
-    *result = (int) thread_count;
+    *result = (int) value;
+    return SUCCESS;
+}
+
+/*
+ * Iteration limit may be written in exponent form, e.g. 1e11.
+ */
+int parse_iteration_limit(const char* string_value, long long* result) {
+    char* end_pointer;
+    errno = 0;
+    double value = strtod(string_value, &end_pointer);
+    if (errno == ERANGE || *end_pointer != '\0') {
+        return EINVAL;
+    }
+    if (value < 1 || value > MAX_ITER_LIMIT || value != (long long) value) {
+        return EINVAL;
+    }
+    *result = (long long) value;
     return SUCCESS;
 }
 
 /*****************************************************************************
- * Threads managing functions: start, gather.
+ * Tasks managing functions: submit, gather.
  ****************************************************************************/
 
-int start_all_threads(pthread_t* threads, thread_workload_t* thread_workload,
-        int thread_count) {
-    int code = set_signal_handler();
-    if (code != SUCCESS) {
-        log_error("Unable to set signal handler", code);
-        return code;
+/*
+ * Function prepares a run over [first_iteration, iteration_limit)
+ * and queues one task per running worker.
+ */
+void submit_all_tasks(thread_pool_t* pool, thread_workload_t** thread_workload,
+        latch_t* latch, long long first_iteration) {
+    int thread_count = pool->worker_count;
+    global_max_iter = first_iteration;
+    chunk_scheduler_reset(&global_scheduler, first_iteration);
+    if (global_telemetry != NULL) {
+        telemetry_start_run(global_telemetry, thread_count,
+            global_scheduler.iteration_limit - first_iteration);
     }
+    fill_threads_workload(thread_workload, thread_count);
+    latch_reset(latch, thread_count);
     for (int i = 0; i < thread_count; ++i) {
-        code = pthread_create(threads + i, DEFAULT_ATTR, compute_pi,
-                                  (void*)(thread_workload + i));
-        if (code != SUCCESS) {
-            return code;
-        }
+        thread_pool_submit_to(pool, i, compute_pi, (void*) thread_workload[i],
+                              latch);
     }
-    return SUCCESS;
 }
 
-int gather_pi_value(pthread_t* threads, int thread_count, double* result) {
-    double pi = 0;
+/*
+ * Progress counters of all threads must add up to the summed range
+ * [first_iteration, global_max_iter).
+ */
+void check_progress(thread_workload_t** thread_workload, int thread_count,
+        long long first_iteration) {
+    long long iter_count = 0;
     for (int i = 0; i < thread_count; ++i) {
-        thread_workload_t* threads_workload;
-        int code = pthread_join(threads[i], (void*)&threads_workload);
+        iter_count += __atomic_load_n(&thread_workload[i]->iter_count,
+                                      __ATOMIC_RELAXED);
+    }
+    if (iter_count != get_global_max_iter() - first_iteration) {
+        fprintf(stderr, "Summed %lld iterations instead of %lld\n",
+            iter_count, get_global_max_iter() - first_iteration);
+    }
+}
+
+/*
+ * Function brings the pool to the target worker count. The remaining
+ * iterations are split between the new set of workers by the next
+ * reset of the scheduler. If workers can not be started the pool
+ * is left as it is.
+ */
+void resize_workers(thread_pool_t* pool, thread_workload_t** threads_workload,
+        thread_workload_t* records) {
+    int thread_count = get_target_thread_count();
+    if (thread_count == pool->worker_count) {
+        return;
+    }
+    int code = thread_pool_resize(pool, thread_count);
+    if (code != SUCCESS) {
+        log_error("Unable to resize workers", code);
+        __atomic_store_n(&global_target_thread_count, pool->worker_count,
+                         __ATOMIC_RELEASE);
+        return;
+    }
+    chunk_scheduler_resize(&global_scheduler, thread_count);
+    point_threads_workload(threads_workload, pool, records);
+    printf("threads = %d\n", thread_count);
+    fflush(stdout);
+}
+
+/*
+ * Function sums [0, iteration_limit) until SIGINT. When workers are
+ * added or removed the run is finished at a consistent prefix and
+ * continued from it by the new set of workers.
+ */
+double run_elastic(thread_pool_t* pool, thread_workload_t** threads_workload,
+        latch_t* latch) {
+    long long first_iteration = 0;
+    double result = 0;
+    do {
+        resize_workers(pool, threads_workload, NULL);
+        submit_all_tasks(pool, threads_workload, latch, first_iteration);
+        latch_wait(latch);
+        check_progress(threads_workload, pool->worker_count, first_iteration);
+        result += thread_pool_gather_results(pool);
+        first_iteration = get_global_max_iter();
+    } while (first_iteration < global_scheduler.iteration_limit &&
+             resume_running() == SUCCESS);
+    return result * global_series->scale;
+}
+
+/*
+ * Function prints value of the series with its error against the exact
+ * value, summed iteration count and, if the run was stopped by a signal,
+ * time passed from the signal until now.
+ */
+void print_run_summary(double value) {
+    printf("\n%s = %.15f\n", global_series->name, value);
+    printf("error = %.1e\n", fabs(value - global_series->exact_value));
+    printf("iterations = %lld\n", get_global_max_iter());
+    if (get_global_state() == STOPPED) {
+        printf("stop latency = %.3f ms\n",
+            (get_time_in_seconds() - global_stop_time) * 1000);
+    }
+}
+
+/*****************************************************************************
+ * Checkpointed run.
+ ****************************************************************************/
+
+/*
+ * Function runs the computation from the committed state of checkpoint.
+ * Every interval seconds workers are brought to a consistent prefix the
+ * same way as on stop, the prefix is committed and the run goes on from
+ * it. A resize is committed the same way. The last commit happens
+ * on SIGINT or when the limit is reached.
+ */
+int run_with_checkpoints(thread_pool_t* pool, latch_t* latch,
+        checkpoint_t* checkpoint, thread_workload_t** thread_workload,
+        double interval, double* value) {
+    checkpoint_state_t state = checkpoint_committed_state(checkpoint);
+    global_max_iter = state.iter_count;
+    set_global_state(RUNNING);
+    while (state.iter_count < global_scheduler.iteration_limit) {
+        resize_workers(pool, thread_workload,
+                       (thread_workload_t*) checkpoint->records);
+        submit_all_tasks(pool, thread_workload, latch, state.iter_count);
+        while (latch_timed_wait(latch, interval) == ETIMEDOUT) {
+            change_global_state(RUNNING, CHECKPOINTING);
+        }
+        check_progress(thread_workload, pool->worker_count, state.iter_count);
+        state.result += thread_pool_gather_results(pool);
+        state.iter_count = get_global_max_iter();
+
+        int code = checkpoint_commit(checkpoint, state);
         if (code != SUCCESS) {
+            log_error("Unable to write checkpoint", code);
             return code;
         }
-        pi += threads_workload->result;
+        if (resume_running() != SUCCESS) {
+            break;
+        }
     }
-    pi *= 4;
-    *result = pi;
+    *value = state.result * global_series->scale;
     return SUCCESS;
 }
 
@@ -195,33 +474,218 @@ int gather_pi_value(pthread_t* threads, int thread_count, double* result) {
  ****************************************************************************/
 
 typedef struct cleanup_data_s {
-    pthread_barrier_t* barrier;
-    thread_workload_t* threads_workload;
+    service_t* service;
+    telemetry_t* telemetry;
+    checkpoint_t* checkpoint;
+    chunk_scheduler_t* scheduler;
+    thread_workload_t** threads_workload;
+    latch_t* latch;
+    thread_pool_t* pool;
 } cleanup_data_t;
 
 void cleanup_routine(void* arg) {
     cleanup_data_t* cleanup_data = (cleanup_data_t*) arg;
-    int code;
-    if (cleanup_data->barrier != NULL) {
-        code = pthread_barrier_destroy(cleanup_data->barrier);
-        log_if_error(code, "Unable to destroy barrier\n");
+    if (cleanup_data->service != NULL) {
+        service_destroy(cleanup_data->service);
+    }
+    if (cleanup_data->pool != NULL) {
+        thread_pool_destroy(cleanup_data->pool);
+    }
+    if (cleanup_data->latch != NULL) {
+        latch_destroy(cleanup_data->latch);
+    }
+    if (cleanup_data->scheduler != NULL) {
+        chunk_scheduler_destroy(cleanup_data->scheduler);
     }
     if (cleanup_data->threads_workload != NULL) {
         free_threads_workload(cleanup_data->threads_workload);
     }
+    if (cleanup_data->checkpoint != NULL) {
+        checkpoint_close(cleanup_data->checkpoint);
+    }
+    if (cleanup_data->telemetry != NULL) {
+        telemetry_destroy(cleanup_data->telemetry);
+    }
+}
+
+typedef struct options_s {
+    int thread_count;
+    int max_thread_count;
+    int repeat_count;
+    long long iteration_limit;
+    const char* checkpoint_path;
+    int resume;
+    double checkpoint_interval;
+    const char* stats_name;
+    const char* placement;
+    const char* series_name;
+    const char* socket_path;
+} options_t;
+
+/*
+ * Function opens checkpoint file with room for per-thread workloads.
+ * When resuming, the iteration limit and the series are taken from
+ * the file unless they were given explicitly; another series, another
+ * chunk size or a limit below the committed prefix can not be continued.
+ */
+int prepare_checkpoint(options_t* options, checkpoint_t* checkpoint,
+        cleanup_data_t* cleanup_data) {
+    int code = checkpoint_open(checkpoint, options->checkpoint_path,
+        options->resume, sizeof(thread_workload_t), options->max_thread_count);
+    if (code != SUCCESS) {
+        log_error("Unable to open checkpoint file", code);
+        return code;
+    }
+    cleanup_data->checkpoint = checkpoint;
+    if (options->resume && options->iteration_limit == 0) {
+        options->iteration_limit = checkpoint->header->iteration_limit;
+    }
+    if (options->iteration_limit == 0) {
+        options->iteration_limit = MAX_ITER_LIMIT;
+    }
+    char* series_name = checkpoint->header->series_name;
+    if (options->resume && options->series_name == NULL) {
+        options->series_name = series_name;
+    }
+    if (options->series_name == NULL) {
+        options->series_name = DEFAULT_SERIES;
+    }
+    if (options->resume && strcmp(series_name, options->series_name) != 0) {
+        log_error("Checkpoint was written for another series", EINVAL);
+        return EINVAL;
+    }
+    if (options->resume && checkpoint->header->chunk_size != CHUNK_ITER_COUNT) {
+        log_error("Checkpoint was written with another chunk size", EINVAL);
+        return EINVAL;
+    }
+    if (options->resume && options->iteration_limit <
+            checkpoint_committed_state(checkpoint).iter_count) {
+        log_error("Iteration limit is below the committed prefix", EINVAL);
+        return EINVAL;
+    }
+    if (series_name != options->series_name) {
+        snprintf(series_name, CHECKPOINT_SERIES_NAME_SIZE, "%s",
+                 options->series_name);
+    }
+    checkpoint->header->iteration_limit = options->iteration_limit;
+    checkpoint->header->chunk_size = CHUNK_ITER_COUNT;
+    return SUCCESS;
+}
+
+void print_placement(int* cpus, int thread_count) {
+    printf("cpus =");
+    for (int i = 0; i < thread_count; ++i) {
+        printf(" %d", cpus[i]);
+    }
+    printf("\n");
 }
 
-int prepare_data(int thread_count, thread_workload_t** threads_workload,
+/*
+ * Workers are pinned if placement is given, CPUs are chosen for all
+ * workers the pool may grow to. Workers allocate local memory for
+ * workloads unless workloads are kept in the checkpoint file.
+ */
+int start_workers(options_t* options, thread_pool_t* pool,
         cleanup_data_t* cleanup_data) {
-    int code = pthread_barrier_init(&global_barrier, DEFAULT_ATTR, thread_count);
+    int max_thread_count = options->max_thread_count;
+    int cpus[max_thread_count];
+    if (options->placement != NULL) {
+        int code = cpu_place_threads(options->placement, max_thread_count,
+                                     cpus);
+        if (code != SUCCESS) {
+            log_error("Unable to place threads", code);
+            return code;
+        }
+        print_placement(cpus, max_thread_count);
+    }
+    size_t local_size = options->checkpoint_path == NULL ?
+        sizeof(thread_workload_t) : 0;
+    int code = thread_pool_init_elastic(pool, options->thread_count,
+        max_thread_count, options->placement != NULL ? cpus : NULL, local_size);
+    if (code != SUCCESS) {
+        log_error("Unable to start threads", code);
+        return code;
+    }
+    cleanup_data->pool = pool;
+    return SUCCESS;
+}
+
+int prepare_data(options_t* options, checkpoint_t* checkpoint,
+        telemetry_t* telemetry, thread_workload_t*** threads_workload,
+        latch_t* latch, thread_pool_t* pool, cleanup_data_t* cleanup_data) {
+    int thread_count = options->thread_count;
+    cleanup_data->service = NULL;
+    cleanup_data->telemetry = NULL;
+    cleanup_data->checkpoint = NULL;
+    cleanup_data->scheduler = NULL;
+    cleanup_data->threads_workload = NULL;
+    cleanup_data->latch = NULL;
+    cleanup_data->pool = NULL;
+
+    int code = set_signal_handler();
     if (code != SUCCESS) {
-        log_error("Unable to initialize barrier", code);
+        log_error("Unable to set signal handler", code);
         return code;
     }
-    cleanup_data->barrier = &global_barrier;
 
-    *threads_workload = allocate_threads_workload(thread_count);
-    if (threads_workload == NULL) {
+    if (options->checkpoint_path != NULL) {
+        code = prepare_checkpoint(options, checkpoint, cleanup_data);
+        if (code != SUCCESS) {
+            return code;
+        }
+    } else if (options->iteration_limit == 0) {
+        options->iteration_limit = MAX_ITER_LIMIT;
+    }
+    if (options->series_name == NULL) {
+        options->series_name = DEFAULT_SERIES;
+    }
+    global_series = series_find(options->series_name);
+    if (global_series == NULL) {
+        log_error("Unknown series in checkpoint", EINVAL);
+        return EINVAL;
+    }
+    const char* kernel_name;
+    global_kernel = series_select_kernel(global_series, &kernel_name);
+    printf("kernel = %s\n", kernel_name);
+
+    code = chunk_scheduler_init(&global_scheduler, options->max_thread_count,
+                                options->iteration_limit, CHUNK_ITER_COUNT);
+    if (code != SUCCESS) {
+        log_error("Unable to initialize scheduler", code);
+        return code;
+    }
+    chunk_scheduler_resize(&global_scheduler, thread_count);
+    cleanup_data->scheduler = &global_scheduler;
+    global_max_thread_count = options->max_thread_count;
+    global_target_thread_count = thread_count;
+
+    if (options->stats_name != NULL) {
+        code = telemetry_create(telemetry, options->stats_name,
+                                options->max_thread_count);
+        if (code != SUCCESS) {
+            log_error("Unable to create stats segment", code);
+            return code;
+        }
+        cleanup_data->telemetry = telemetry;
+        global_telemetry = telemetry;
+    }
+
+    code = latch_init(latch, 0);
+    if (code != SUCCESS) {
+        log_error("Unable to initialize latch", code);
+        return code;
+    }
+    cleanup_data->latch = latch;
+
+    code = start_workers(options, pool, cleanup_data);
+    if (code != SUCCESS) {
+        return code;
+    }
+
+    *threads_workload = allocate_threads_workload(pool,
+        options->checkpoint_path != NULL ?
+            (thread_workload_t*) checkpoint->records : NULL);
+    if (*threads_workload == NULL) {
         log_error("Unable to allocate threads data", ENOMEM);
         return FAILURE;
     }
@@ -231,39 +695,188 @@ int prepare_data(int thread_count, thread_workload_t** threads_workload,
 }
 
 
-int main(int argc, const char *argv[]) {
-    if (argc != ARGS_REQUIRED) {
+void parse_arg_or_exit_if_error(int argc, char *argv[], options_t* options) {
+    static const struct option long_options[] = {
+        { "checkpoint", required_argument, NULL, 'c' },
+        { "resume", no_argument, NULL, 'r' },
+        { "interval", required_argument, NULL, 'i' },
+        { "stats", required_argument, NULL, 's' },
+        { "affinity", required_argument, NULL, 'a' },
+        { "series", required_argument, NULL, 'S' },
+        { "serve", required_argument, NULL, 'd' },
+        { "max-threads", required_argument, NULL, 'm' },
+        { NULL, 0, NULL, 0 }
+    };
+    options->repeat_count = 1;
+    options->iteration_limit = 0;
+    options->checkpoint_path = NULL;
+    options->resume = 0;
+    options->checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
+    options->stats_name = NULL;
+    options->placement = NULL;
+    options->series_name = NULL;
+    options->socket_path = NULL;
+    options->max_thread_count = 0;
+
+    int option;
+    while ((option = getopt_long(argc, argv, "c:ri:s:a:S:d:m:", long_options, NULL)) != -1) {
+        if (option == 'c') {
+            options->checkpoint_path = optarg;
+        } else if (option == 'r') {
+            options->resume = 1;
+        } else if (option == 's') {
+            options->stats_name = optarg;
+        } else if (option == 'a') {
+            options->placement = optarg;
+        } else if (option == 'd') {
+            options->socket_path = optarg;
+        } else if (option == 'm') {
+            if (parse_positive_number(optarg, &options->max_thread_count)
+                    != SUCCESS) {
+                exit_with_custom_message("Max thread count must be \
+                    a positive number", EXIT_FAILURE);
+            }
+        } else if (option == 'S') {
+            if (series_find(optarg) == NULL) {
+                exit_with_custom_message("Series must be one of \
+                    pi, ln2, zeta2, catalan", EXIT_FAILURE);
+            }
+            options->series_name = optarg;
+        } else if (option == 'i') {
+            char* end_pointer;
+            options->checkpoint_interval = strtod(optarg, &end_pointer);
+            if (*end_pointer != '\0' || options->checkpoint_interval <= 0) {
+                exit_with_custom_message("Checkpoint interval must be \
+                    a positive number of seconds", EXIT_FAILURE);
+            }
+        } else {
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    int positional_count = argc - optind;
+    if (positional_count < MIN_ARGS_COUNT || positional_count > MAX_ARGS_COUNT) {
         print_usage();
         exit(EXIT_FAILURE);
     }
-    int thread_count;
-    int code = parse_thread_count(argv[1], &thread_count);
-    if (code != SUCCESS) {
+    if (parse_positive_number(argv[optind], &options->thread_count) != SUCCESS) {
         exit_with_custom_message("Thread count parameter must be \
             a positive number", EXIT_FAILURE);
     }
+    if (positional_count > 1 &&
+            parse_positive_number(argv[optind + 1], &options->repeat_count)
+                != SUCCESS) {
+        exit_with_custom_message("Repeat count parameter must be \
+            a positive number", EXIT_FAILURE);
+    }
+    if (positional_count > 2 &&
+            parse_iteration_limit(argv[optind + 2], &options->iteration_limit)
+                != SUCCESS) {
+        exit_with_custom_message("Iteration limit must be \
+            a positive integer not greater than 2^50", EXIT_FAILURE);
+    }
+    /* By default the workers may grow to one per online CPU */
+    if (options->max_thread_count == 0) {
+        long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        options->max_thread_count = cpu_count > options->thread_count ?
+            (int) cpu_count : options->thread_count;
+    }
+    if (options->max_thread_count < options->thread_count) {
+        exit_with_custom_message("Max thread count must not be less \
+            than thread count", EXIT_FAILURE);
+    }
+    if (options->checkpoint_path == NULL && options->resume) {
+        exit_with_custom_message("--resume requires --checkpoint", EXIT_FAILURE);
+    }
+    if (options->checkpoint_path != NULL && options->repeat_count != 1) {
+        exit_with_custom_message("Checkpointed computation can not be \
+            repeated", EXIT_FAILURE);
+    }
+    if (options->socket_path != NULL && (positional_count > 1 ||
+            options->checkpoint_path != NULL || options->stats_name != NULL)) {
+        exit_with_custom_message("--serve takes only thread count and \
+            --affinity", EXIT_FAILURE);
+    }
+}
 
-    cleanup_data_t cleanup_data;
-    thread_workload_t *threads_workload;
-    code = prepare_data(thread_count, &threads_workload, &cleanup_data);
+/*
+ * Function answers requests on socket_path with the workers of pool
+ * until SIGINT, then prints statistics of the service.
+ */
+int run_service(const char* socket_path, thread_pool_t* pool,
+        service_t* service, cleanup_data_t* cleanup_data) {
+    int code = service_init(service, socket_path, pool);
     if (code != SUCCESS) {
-        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) &cleanup_data);
+        log_error("Unable to create service socket", code);
+        return code;
+    }
+    cleanup_data->service = service;
+    global_service = service;
+    if (get_global_state() == STOPPED) {
+        service_stop(service);
     }
+    printf("serving on %s\n", socket_path);
+    fflush(stdout);
 
-    pthread_t threads[thread_count];
-    code = start_all_threads(threads, threads_workload, thread_count);
+    code = service_run(service);
     if (code != SUCCESS) {
-        log_error("Unable to start threads", code);
-        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) &cleanup_data);
+        log_error("Unable to serve requests", code);
+        return code;
     }
+    service_stats_t* stats = &service->stats;
+    printf("\nrequests = %lld\n", stats->request_count);
+    printf("errors = %lld\n", stats->error_count);
+    printf("cache hits = %lld\n", stats->cache_hit_count);
+    printf("batches = %lld (%.2f requests per batch)\n", stats->batch_count,
+        stats->batch_count > 0 ?
+            (double) stats->request_count / stats->batch_count : 0);
+    printf("iterations = %lld\n", stats->term_count);
+    return SUCCESS;
+}
 
-    double pi = 0;
-    code = gather_pi_value(threads, thread_count, &pi);
+
+int main(int argc, char *argv[]) {
+    options_t options;
+    parse_arg_or_exit_if_error(argc, argv, &options);
+
+    cleanup_data_t cleanup_data;
+    checkpoint_t checkpoint;
+    telemetry_t telemetry;
+    thread_workload_t **threads_workload;
+    latch_t latch;
+    thread_pool_t pool;
+    int code = prepare_data(&options, &checkpoint, &telemetry,
+                            &threads_workload, &latch, &pool, &cleanup_data);
     if (code != SUCCESS) {
-        log_error("Unable to join threads", code);
         exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) &cleanup_data);
     }
 
-    printf("\npi = %.15f\n", pi);
+    if (options.socket_path != NULL) {
+        service_t service;
+        code = run_service(options.socket_path, &pool, &service, &cleanup_data);
+        exit_with_cleanup(code == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE,
+                          cleanup_routine, (void*) &cleanup_data);
+    }
+
+    if (options.checkpoint_path != NULL) {
+        double value;
+        code = run_with_checkpoints(&pool, &latch, &checkpoint, threads_workload,
+            options.checkpoint_interval, &value);
+        if (code != SUCCESS) {
+            exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) &cleanup_data);
+        }
+        print_run_summary(value);
+        exit_with_cleanup(EXIT_SUCCESS, cleanup_routine, (void*) &cleanup_data);
+    }
+
+    /*
+     * Every run lasts until SIGINT or until the iteration limit,
+     * the workers are reused between runs.
+     */
+    for (int run = 0; run < options.repeat_count; ++run) {
+        set_global_state(RUNNING);
+        double value = run_elastic(&pool, threads_workload, &latch);
+        print_run_summary(value);
+    }
     exit_with_cleanup(EXIT_SUCCESS, cleanup_routine, (void*) &cleanup_data);
 }
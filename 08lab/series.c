@@ -0,0 +1,109 @@
+#include <string.h>
+#include "series.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SERIES_X86
+#endif
+
+#define SERIES_LANES 4
+
+/*
+ * Terms are evaluated on SERIES_LANES consecutive indices at once with
+ * GCC vector extensions, so the generated loop is vectorized whatever
+ * the cost model of the optimizer says. On the baseline instruction set
+ * a vector takes two SSE2 registers.
+ */
+typedef double series_vector_t __attribute__((vector_size(
+    SERIES_LANES * sizeof(double))));
+
+/*
+ * Macro defines kernel name(from, to) summing term, an expression of k,
+ * for k in [from, to). The term is expanded in place for vectors of
+ * indices and for the scalar tail, so there is no call per term.
+ * Two independent accumulators keep consecutive divisions from waiting
+ * for each other.
+ */
+#define DEFINE_SERIES_KERNEL(name, attributes, k, term)                      \
+    attributes static double name(long long from, long long to) {           \
+        series_vector_t sum0 = { 0 };                                        \
+        series_vector_t sum1 = { 0 };                                        \
+        series_vector_t first = { 0, 1, 2, 3 };                              \
+        first += (double) from;                                              \
+        long long index = from;                                              \
+        for ( ; to - index >= 2 * SERIES_LANES; index += 2 * SERIES_LANES) { \
+            {                                                                \
+                series_vector_t k = first;                                   \
+                sum0 += (term);                                              \
+            }                                                                \
+            {                                                                \
+                series_vector_t k = first + SERIES_LANES;                    \
+                sum1 += (term);                                              \
+            }                                                                \
+            first += 2 * SERIES_LANES;                                       \
+        }                                                                    \
+        sum0 += sum1;                                                        \
+        double result = sum0[0] + sum0[1] + sum0[2] + sum0[3];               \
+        for ( ; index < to; ++index) {                                       \
+            double k = (double) index;                                       \
+            result += (term);                                                \
+        }                                                                    \
+        return result;                                                       \
+    }
+
+#ifdef SERIES_X86
+#define DEFINE_SERIES(name, k, term)                                         \
+    DEFINE_SERIES_KERNEL(name##_generic, , k, term)                          \
+    DEFINE_SERIES_KERNEL(name##_avx2,                                        \
+        __attribute__((target("avx2,fma"))), k, term)
+#else
+/* The AVX2 kernel is never selected here, it only fills the table */
+#define DEFINE_SERIES(name, k, term)                                         \
+    DEFINE_SERIES_KERNEL(name##_generic, , k, term)                          \
+    DEFINE_SERIES_KERNEL(name##_avx2, , k, term)
+#endif
+
+/*****************************************************************************
+ * Series. Alternating series are summed by pairs of terms.
+ ****************************************************************************/
+
+/* pi / 4 = 1 - 1/3 + 1/5 - ... */
+DEFINE_SERIES(leibniz, k, 1.0 / (4.0 * k + 1.0) - 1.0 / (4.0 * k + 3.0))
+
+/* ln 2 = 1 - 1/2 + 1/3 - ... */
+DEFINE_SERIES(ln2, k, 1.0 / (2.0 * k + 1.0) - 1.0 / (2.0 * k + 2.0))
+
+/* zeta(2) = pi^2 / 6 = 1 + 1/4 + 1/9 + ... */
+DEFINE_SERIES(zeta2, k, 1.0 / ((k + 1.0) * (k + 1.0)))
+
+/* Catalan's constant G = 1 - 1/9 + 1/25 - ... */
+DEFINE_SERIES(catalan, k, 1.0 / ((4.0 * k + 1.0) * (4.0 * k + 1.0)) -
+                          1.0 / ((4.0 * k + 3.0) * (4.0 * k + 3.0)))
+
+static const series_t SERIES[] = {
+    { "pi", 4, 3.14159265358979323846, leibniz_generic, leibniz_avx2 },
+    { "ln2", 1, 0.69314718055994530942, ln2_generic, ln2_avx2 },
+    { "zeta2", 1, 1.64493406684822643647, zeta2_generic, zeta2_avx2 },
+    { "catalan", 1, 0.91596559417721901505, catalan_generic, catalan_avx2 },
+};
+
+const series_t* series_find(const char* name) {
+    for (size_t i = 0; i < sizeof(SERIES) / sizeof(SERIES[0]); ++i) {
+        if (strcmp(SERIES[i].name, name) == 0) {
+            return SERIES + i;
+        }
+    }
+    return NULL;
+}
+
+series_kernel_t series_select_kernel(const series_t* series,
+        const char** kernel_name) {
+#ifdef SERIES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        *kernel_name = "avx2";
+        return series->avx2_kernel;
+    }
+#endif
+    *kernel_name = "generic";
+    return series->generic_kernel;
+}
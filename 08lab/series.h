@@ -0,0 +1,35 @@
+#ifndef series_h
+#define series_h
+
+/*
+ * Kernel returns sum of terms with indices in [from, to).
+ */
+typedef double (*series_kernel_t)(long long from, long long to);
+
+/*
+ * Series summed by the parallel driver: value = scale * sum of terms
+ * for k = 0, 1, ... Every series has a kernel built for the baseline
+ * instruction set and one built for AVX2 and FMA.
+ */
+typedef struct series_s {
+    const char* name;
+    double scale;
+    double exact_value;
+    series_kernel_t generic_kernel;
+    series_kernel_t avx2_kernel;
+} series_t;
+
+/*
+ * Function returns series with name or NULL: "pi" (Leibniz series),
+ * "ln2", "zeta2" or "catalan".
+ */
+const series_t* series_find(const char* name);
+
+/*
+ * Function returns the widest kernel of series supported by the CPU
+ * and stores its name ("avx2" or "generic") in kernel_name.
+ */
+series_kernel_t series_select_kernel(const series_t* series,
+        const char** kernel_name);
+
+#endif /* series_h */
@@ -0,0 +1,559 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "service.h"
+
+#define SERVICE_BACKLOG 64
+/* A few seconds of work for a single worker */
+#define SERVICE_MAX_TERM_COUNT 10000000000LL
+/* Ranges shorter than that are not split between workers */
+#define SERVICE_MIN_PART_SIZE (1LL << 20)
+/* A line takes at least a byte, so that is the most requests
+ * that can be taken from all clients in a single batch */
+#define SERVICE_MAX_BATCH_SIZE (SERVICE_MAX_CLIENTS * SERVICE_REQUEST_SIZE)
+#define SERVICE_SERIES_NAME_SIZE 16
+#define SERVICE_REPLY_SIZE 64
+
+/*
+ * Request of a batch. The sum starts from base, the longest cached
+ * prefix of the requested range. error is the reason the request
+ * is rejected or NULL.
+ */
+typedef struct service_request_s {
+    int client;
+    const char* error;
+    const series_t* series;
+    long long term_count;
+    prefix_sum_t base;
+    double sum;
+} service_request_t;
+
+/*
+ * Piece [from, to) of the iteration space of series between two
+ * neighbouring requested bounds. depth is the number of requests
+ * covering it, only covered pieces are summed.
+ */
+typedef struct piece_s {
+    const series_t* series;
+    long long from;
+    long long to;
+    int depth;
+    double sum;
+} piece_t;
+
+/*
+ * Part of a piece summed by a single task.
+ */
+typedef struct part_s {
+    series_kernel_t kernel;
+    long long from;
+    long long to;
+    double sum;
+} part_t;
+
+/*****************************************************************************
+ * Cache of prefix sums.
+ ****************************************************************************/
+
+/*
+ * Function returns the longest cached prefix of the first term_count
+ * terms of series, the empty prefix if there is none.
+ */
+static prefix_sum_t find_prefix(service_t* service, const series_t* series,
+        long long term_count) {
+    prefix_sum_t best = { series, 0, 0 };
+    for (int i = 0; i < service->cache_size; ++i) {
+        prefix_sum_t* entry = service->cache + i;
+        if (entry->series == series && entry->term_count <= term_count &&
+                entry->term_count > best.term_count) {
+            best = *entry;
+        }
+    }
+    return best;
+}
+
+static void cache_prefix(service_t* service, prefix_sum_t prefix) {
+    prefix_sum_t found = find_prefix(service, prefix.series, prefix.term_count);
+    if (found.term_count == prefix.term_count) {
+        return;
+    }
+    service->cache[service->cache_next] = prefix;
+    service->cache_next = (service->cache_next + 1) % SERVICE_CACHE_SIZE;
+    if (service->cache_size < SERVICE_CACHE_SIZE) {
+        ++service->cache_size;
+    }
+}
+
+/*****************************************************************************
+ * Batch computation.
+ ****************************************************************************/
+
+static int compare_pieces(const piece_t* left, const series_t* series,
+        long long from) {
+    if (left->series != series) {
+        return left->series < series ? -1 : 1;
+    }
+    return left->from < from ? -1 : left->from > from;
+}
+
+static int compare_bounds(const void* left, const void* right) {
+    const piece_t* bound = (const piece_t*) right;
+    return compare_pieces((const piece_t*) left, bound->series, bound->from);
+}
+
+/*
+ * Function returns index of the first piece that is not before
+ * (series, from) in pieces sorted by series and from.
+ */
+static int find_piece(piece_t* pieces, int piece_count, const series_t* series,
+        long long from) {
+    int low = 0;
+    int high = piece_count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (compare_pieces(pieces + middle, series, from) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static void sum_part(void* arg, pool_worker_t* worker) {
+    part_t* part = (part_t*) arg;
+    part->sum = part->kernel(part->from, part->to);
+}
+
+/*
+ * Function sums covered pieces on the pool. Every piece is split in
+ * at most worker_count parts of SERVICE_MIN_PART_SIZE terms or more,
+ * parts are added up in order, so the sum of a piece does not depend
+ * on timing. Returns SUCCESS or ENOMEM.
+ */
+static int sum_pieces(service_t* service, piece_t* pieces, int piece_count) {
+    if (piece_count == 0) {
+        return SUCCESS;
+    }
+    int worker_count = service->pool->worker_count;
+    part_t* parts = (part_t*)malloc(
+        (size_t) piece_count * worker_count * sizeof(part_t));
+    int* part_counts = (int*)malloc(piece_count * sizeof(int));
+    if (parts == NULL || part_counts == NULL) {
+        free(parts);
+        free(part_counts);
+        return ENOMEM;
+    }
+
+    int part_count = 0;
+    for (int i = 0; i < piece_count; ++i) {
+        piece_t* piece = pieces + i;
+        long long size = piece->to - piece->from;
+        long long count = (size + SERVICE_MIN_PART_SIZE - 1) / SERVICE_MIN_PART_SIZE;
+        part_counts[i] = piece->depth > 0 ?
+            (count < worker_count ? (int) count : worker_count) : 0;
+        const char* kernel_name;
+        series_kernel_t kernel = series_select_kernel(piece->series, &kernel_name);
+        for (int j = 0; j < part_counts[i]; ++j) {
+            part_t* part = parts + part_count + j;
+            part->kernel = kernel;
+            part->from = piece->from + size * j / part_counts[i];
+            part->to = piece->from + size * (j + 1) / part_counts[i];
+            part->sum = 0;
+        }
+        part_count += part_counts[i];
+        if (piece->depth > 0) {
+            service->stats.term_count += size;
+        }
+    }
+
+    latch_reset(&service->latch, part_count);
+    for (int i = 0; i < part_count; ++i) {
+        thread_pool_submit(service->pool, sum_part, parts + i, &service->latch);
+    }
+    latch_wait(&service->latch);
+
+    part_t* part = parts;
+    for (int i = 0; i < piece_count; ++i) {
+        pieces[i].sum = 0;
+        for (int j = 0; j < part_counts[i]; ++j, ++part) {
+            pieces[i].sum += part->sum;
+        }
+    }
+    free(parts);
+    free(part_counts);
+    return SUCCESS;
+}
+
+/*
+ * Function splits ranges [base, term_count) of requests that are not
+ * answered by the cache at every requested bound, sums the pieces
+ * covered by some request once and adds them up for every request.
+ * Returns SUCCESS or ENOMEM.
+ */
+static int compute_requests(service_t* service, service_request_t* requests,
+        int request_count) {
+    piece_t* bounds = (piece_t*)malloc(2 * request_count * sizeof(piece_t));
+    if (bounds == NULL) {
+        return ENOMEM;
+    }
+    int bound_count = 0;
+    for (int i = 0; i < request_count; ++i) {
+        service_request_t* request = requests + i;
+        if (request->error != NULL ||
+                request->base.term_count == request->term_count) {
+            continue;
+        }
+        bounds[bound_count].series = request->series;
+        bounds[bound_count++].from = request->base.term_count;
+        bounds[bound_count].series = request->series;
+        bounds[bound_count++].from = request->term_count;
+    }
+    qsort(bounds, bound_count, sizeof(piece_t), compare_bounds);
+
+    /* Piece i spans from bound i to the next bound of the same series,
+     * the last bound of a series only terminates the previous piece */
+    int piece_count = 0;
+    for (int i = 0; i < bound_count; ++i) {
+        if (piece_count > 0 && compare_bounds(bounds + piece_count - 1,
+                bounds + i) == 0) {
+            continue;
+        }
+        bounds[piece_count] = bounds[i];
+        bounds[piece_count].depth = 0;
+        if (piece_count > 0 &&
+                bounds[piece_count - 1].series == bounds[i].series) {
+            bounds[piece_count - 1].to = bounds[i].from;
+        } else if (piece_count > 0) {
+            bounds[piece_count - 1].to = bounds[piece_count - 1].from;
+        }
+        ++piece_count;
+    }
+    if (piece_count > 0) {
+        bounds[piece_count - 1].to = bounds[piece_count - 1].from;
+    }
+
+    piece_t* pieces = bounds;
+    for (int i = 0; i < request_count; ++i) {
+        service_request_t* request = requests + i;
+        if (request->error != NULL ||
+                request->base.term_count == request->term_count) {
+            continue;
+        }
+        int first = find_piece(pieces, piece_count, request->series,
+                               request->base.term_count);
+        int last = find_piece(pieces, piece_count, request->series,
+                              request->term_count);
+        for (int j = first; j < last; ++j) {
+            ++pieces[j].depth;
+        }
+    }
+
+    int code = sum_pieces(service, pieces, piece_count);
+    if (code != SUCCESS) {
+        free(pieces);
+        return code;
+    }
+
+    for (int i = 0; i < request_count; ++i) {
+        service_request_t* request = requests + i;
+        if (request->error != NULL) {
+            continue;
+        }
+        request->sum = request->base.sum;
+        if (request->base.term_count == request->term_count) {
+            continue;
+        }
+        int first = find_piece(pieces, piece_count, request->series,
+                               request->base.term_count);
+        int last = find_piece(pieces, piece_count, request->series,
+                              request->term_count);
+        for (int j = first; j < last; ++j) {
+            request->sum += pieces[j].sum;
+        }
+    }
+    free(pieces);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+ * Clients.
+ ****************************************************************************/
+
+static void close_client(service_client_t* client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+/*
+ * Function removes closed clients keeping the order of the others.
+ */
+static void remove_closed_clients(service_t* service) {
+    int count = 0;
+    for (int i = 0; i < service->client_count; ++i) {
+        if (service->clients[i].fd >= 0) {
+            if (count != i) {
+                service->clients[count] = service->clients[i];
+            }
+            ++count;
+        }
+    }
+    service->client_count = count;
+}
+
+static void accept_clients(service_t* service) {
+    while (service->client_count < SERVICE_MAX_CLIENTS) {
+        int fd = accept4(service->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        service_client_t* client = service->clients + service->client_count++;
+        client->fd = fd;
+        client->length = 0;
+    }
+}
+
+/*
+ * Term count may be written in exponent form, e.g. 1e9.
+ */
+static const char* parse_request(const char* line, service_request_t* request) {
+    char name[SERVICE_SERIES_NAME_SIZE];
+    char number[32];
+    char rest;
+    if (sscanf(line, "%15s %31s %c", name, number, &rest) != 2) {
+        return "expected <series> <term_count>";
+    }
+    request->series = series_find(name);
+    if (request->series == NULL) {
+        return "unknown series";
+    }
+    char* end_pointer;
+    errno = 0;
+    double value = strtod(number, &end_pointer);
+    if (errno == ERANGE || *end_pointer != '\0' || value < 1 ||
+            value > SERVICE_MAX_TERM_COUNT || value != (long long) value) {
+        return "term count must be an integer from 1 to 1e10";
+    }
+    request->term_count = (long long) value;
+    return NULL;
+}
+
+/*
+ * Function receives what client has sent and adds its complete lines
+ * to requests. A line that does not fit in the buffer is rejected.
+ * A client that has disconnected is closed.
+ */
+static void read_requests(service_t* service, int client_id,
+        service_request_t* requests, int* request_count) {
+    service_client_t* client = service->clients + client_id;
+    ssize_t received = recv(client->fd, client->buffer + client->length,
+        SERVICE_REQUEST_SIZE - client->length, MSG_DONTWAIT);
+    if (received < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    if (received <= 0) {
+        close_client(client);
+        return;
+    }
+    client->length += received;
+
+    char* line = client->buffer;
+    char* end;
+    while ((end = memchr(line, '\n', client->buffer + client->length - line))
+            != NULL) {
+        *end = '\0';
+        service_request_t* request = requests + (*request_count)++;
+        request->client = client_id;
+        request->error = parse_request(line, request);
+        line = end + 1;
+    }
+    client->length -= line - client->buffer;
+    memmove(client->buffer, line, client->length);
+    if (client->length == SERVICE_REQUEST_SIZE) {
+        service_request_t* request = requests + (*request_count)++;
+        request->client = client_id;
+        request->error = "request is too long";
+        client->length = 0;
+    }
+}
+
+/*
+ * Replies go to the socket buffer without waiting, a client that
+ * does not read them is disconnected instead of blocking the others.
+ */
+static void send_reply(service_t* service, service_request_t* request) {
+    service_client_t* client = service->clients + request->client;
+    if (client->fd < 0) {
+        return;
+    }
+    char reply[SERVICE_REPLY_SIZE];
+    int length = request->error != NULL ?
+        snprintf(reply, sizeof(reply), "error: %s\n", request->error) :
+        snprintf(reply, sizeof(reply), "%.17g\n",
+                 request->sum * request->series->scale);
+    if (length >= (int) sizeof(reply)) {
+        length = sizeof(reply) - 1;
+        reply[length - 1] = '\n';
+    }
+    if (send(client->fd, reply, length, MSG_DONTWAIT | MSG_NOSIGNAL) != length) {
+        close_client(client);
+    }
+}
+
+/*****************************************************************************
+ * Service.
+ ****************************************************************************/
+
+static int process_batch(service_t* service, service_request_t* requests,
+        int request_count) {
+    for (int i = 0; i < request_count; ++i) {
+        service_request_t* request = requests + i;
+        if (request->error != NULL) {
+            continue;
+        }
+        request->base = find_prefix(service, request->series,
+                                    request->term_count);
+        if (request->base.term_count == request->term_count) {
+            ++service->stats.cache_hit_count;
+        }
+    }
+
+    int code = compute_requests(service, requests, request_count);
+    if (code != SUCCESS) {
+        return code;
+    }
+
+    for (int i = 0; i < request_count; ++i) {
+        service_request_t* request = requests + i;
+        if (request->error == NULL) {
+            prefix_sum_t prefix = { request->series, request->term_count,
+                                    request->sum };
+            cache_prefix(service, prefix);
+        } else {
+            ++service->stats.error_count;
+        }
+        send_reply(service, request);
+    }
+    service->stats.request_count += request_count;
+    ++service->stats.batch_count;
+    return SUCCESS;
+}
+
+int service_init(service_t* service, const char* path, thread_pool_t* pool) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return ENAMETOOLONG;
+    }
+    strcpy(address.sun_path, path);
+
+    /* Only a socket left by a previous daemon may be replaced */
+    struct stat status;
+    if (stat(path, &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            return EEXIST;
+        }
+        unlink(path);
+    }
+
+    service->path = path;
+    service->pool = pool;
+    service->stopping = 0;
+    service->client_count = 0;
+    service->cache_size = 0;
+    service->cache_next = 0;
+    memset(&service->stats, 0, sizeof(service->stats));
+    int code = latch_init(&service->latch, 0);
+    if (code != SUCCESS) {
+        return code;
+    }
+    service->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+                                SOCK_CLOEXEC, 0);
+    if (service->listen_fd < 0) {
+        code = errno;
+        latch_destroy(&service->latch);
+        return code;
+    }
+    if (bind(service->listen_fd, (struct sockaddr*) &address,
+                sizeof(address)) != 0 ||
+            listen(service->listen_fd, SERVICE_BACKLOG) != 0) {
+        code = errno;
+        close(service->listen_fd);
+        latch_destroy(&service->latch);
+        return code;
+    }
+    return SUCCESS;
+}
+
+int service_run(service_t* service) {
+    service_request_t* requests = (service_request_t*)malloc(
+        SERVICE_MAX_BATCH_SIZE * sizeof(service_request_t));
+    if (requests == NULL) {
+        return ENOMEM;
+    }
+    struct pollfd fds[SERVICE_MAX_CLIENTS + 1];
+    int code = SUCCESS;
+    while (!__atomic_load_n(&service->stopping, __ATOMIC_ACQUIRE)) {
+        /* The listening socket is left out while there is no room
+         * for more clients, new connections wait in its backlog */
+        int client_count = service->client_count;
+        for (int i = 0; i < client_count; ++i) {
+            fds[i].fd = service->clients[i].fd;
+            fds[i].events = POLLIN;
+        }
+        fds[client_count].fd = service->listen_fd;
+        fds[client_count].events = POLLIN;
+        int fd_count = client_count < SERVICE_MAX_CLIENTS ?
+            client_count + 1 : client_count;
+        if (poll(fds, fd_count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            code = errno;
+            break;
+        }
+
+        /* Everything that has arrived while the previous batch
+         * was computed makes the next batch */
+        int request_count = 0;
+        for (int i = 0; i < client_count; ++i) {
+            if (fds[i].revents != 0) {
+                read_requests(service, i, requests, &request_count);
+            }
+        }
+        if (request_count > 0) {
+            code = process_batch(service, requests, request_count);
+            if (code != SUCCESS) {
+                break;
+            }
+        }
+        remove_closed_clients(service);
+        if (fd_count > client_count && fds[client_count].revents != 0) {
+            accept_clients(service);
+        }
+    }
+    free(requests);
+    return code;
+}
+
+void service_stop(service_t* service) {
+    __atomic_store_n(&service->stopping, 1, __ATOMIC_RELEASE);
+}
+
+void service_destroy(service_t* service) {
+    for (int i = 0; i < service->client_count; ++i) {
+        close_client(service->clients + i);
+    }
+    close(service->listen_fd);
+    unlink(service->path);
+    latch_destroy(&service->latch);
+}
@@ -0,0 +1,90 @@
+#ifndef service_h
+#define service_h
+
+#include "../utils/thread_pool.h"
+#include "../utils/latch.h"
+#include "series.h"
+
+#define SERVICE_MAX_CLIENTS 256
+#define SERVICE_REQUEST_SIZE 64
+#define SERVICE_CACHE_SIZE 1024
+
+/*
+ * Sum of the first term_count terms of series.
+ */
+typedef struct prefix_sum_s {
+    const series_t* series;
+    long long term_count;
+    double sum;
+} prefix_sum_t;
+
+/*
+ * Connection of a client. buffer holds the received part
+ * of the requests that are not complete yet.
+ */
+typedef struct service_client_s {
+    int fd;
+    size_t length;
+    char buffer[SERVICE_REQUEST_SIZE];
+} service_client_t;
+
+typedef struct service_stats_s {
+    long long request_count;
+    long long error_count;
+    long long cache_hit_count;
+    long long batch_count;
+    long long term_count;
+} service_stats_t;
+
+/*
+ * Daemon answering requests "<series> <term_count>\n" on a Unix domain
+ * socket with the value of the series, "%.17g\n", or "error: <reason>\n".
+ * Sums are computed by the workers of pool, which stay warm between
+ * requests. Prefix sums of answered requests are kept in cache, which
+ * is replaced in FIFO order.
+ */
+typedef struct service_s {
+    const char* path;
+    int listen_fd;
+    int stopping;
+    thread_pool_t* pool;
+    latch_t latch;
+    int client_count;
+    service_client_t clients[SERVICE_MAX_CLIENTS];
+    int cache_size;
+    int cache_next;
+    prefix_sum_t cache[SERVICE_CACHE_SIZE];
+    service_stats_t stats;
+} service_t;
+
+/*
+ * Function creates the socket at path, replacing a stale one.
+ * Returns SUCCESS or error code.
+ */
+int service_init(service_t* service, const char* path, thread_pool_t* pool);
+
+/*
+ * Function serves clients until service_stop() is called.
+ *
+ * Requests are handled in batches: all requests that have arrived while
+ * the previous batch was computed are taken at once. Requests for the
+ * same series share their common prefix of the iteration space: the
+ * range up to the largest term count is split at every requested term
+ * count and every piece is summed once. Summing starts from the longest
+ * cached prefix, so repeated requests cost no computation at all.
+ *
+ * Returns SUCCESS or error code.
+ */
+int service_run(service_t* service);
+
+/*
+ * Function makes service_run() return. It is async-signal-safe.
+ */
+void service_stop(service_t* service);
+
+/*
+ * Function closes all connections and removes the socket.
+ */
+void service_destroy(service_t* service);
+
+#endif /* service_h */
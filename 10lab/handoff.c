@@ -0,0 +1,438 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include "../utils/util.h"
+#include "../utils/futex.h"
+#include "../utils/latch.h"
+#include "handoff.h"
+
+/*
+ * Futex words of different threads are a cache line apart.
+ */
+#define WORD_STRIDE (CACHE_LINE_SIZE / sizeof(int))
+#define SPIN_COUNT 1000
+
+/* States of a futex word: not our turn, our turn, parked waiting */
+#define WORD_WAITING 0
+#define WORD_READY 1
+#define WORD_PARKED 2
+
+typedef struct handoff_thread_s {
+    handoff_t* handoff;
+    const handoff_method_t* method;
+    double* latencies;
+    latch_t* ready;
+    latch_t* start;
+    int thread_id;
+} handoff_thread_t;
+
+static int next_thread(handoff_t* handoff, int thread_id) {
+    return (thread_id + 1) % handoff->thread_count;
+}
+
+static void nothing(handoff_t* handoff, int thread_id) {
+}
+
+/*****************************************************************************
+ * Mutex ring. Turn k locks mutex k mod (n + 1) and unlocks the mutex
+ * the thread locked on its previous turn, k - n. So turn k can only
+ * start when turn k - 1 has unlocked the mutex it needs. For two threads
+ * that is the order of the three mutexes 10lab used to print text with.
+ ****************************************************************************/
+
+static void destroy_mutexes(handoff_t* handoff, int count) {
+    for (int i = 0; i < count; ++i) {
+        pthread_mutex_destroy(handoff->mutexes + i);
+    }
+    free(handoff->mutexes);
+    free(handoff->held_mutexes);
+}
+
+static int init_mutex_ring(handoff_t* handoff) {
+    int count = handoff->thread_count + 1;
+    handoff->mutexes = (pthread_mutex_t*)malloc(count * sizeof(pthread_mutex_t));
+    handoff->held_mutexes = (int*)malloc(handoff->thread_count * sizeof(int));
+    if (handoff->mutexes == NULL || handoff->held_mutexes == NULL) {
+        destroy_mutexes(handoff, 0);
+        return ENOMEM;
+    }
+    pthread_mutexattr_t attributes;
+    int code = pthread_mutexattr_init(&attributes);
+    if (code != SUCCESS) {
+        destroy_mutexes(handoff, 0);
+        return code;
+    }
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_ERRORCHECK);
+    for (int i = 0; i < count; ++i) {
+        code = pthread_mutex_init(handoff->mutexes + i, &attributes);
+        if (code != SUCCESS) {
+            destroy_mutexes(handoff, i);
+            break;
+        }
+    }
+    pthread_mutexattr_destroy(&attributes);
+    return code;
+}
+
+/*
+ * Before the first turn thread i holds mutex i + 1, as if it had
+ * taken turn i - n.
+ */
+static void lock_first_mutex(handoff_t* handoff, int thread_id) {
+    handoff->held_mutexes[thread_id] = thread_id + 1;
+    pthread_mutex_lock(handoff->mutexes + thread_id + 1);
+}
+
+static void lock_turn_mutex(handoff_t* handoff, int thread_id, long long turn) {
+    pthread_mutex_lock(handoff->mutexes + turn % (handoff->thread_count + 1));
+}
+
+static void unlock_previous_mutex(handoff_t* handoff, int thread_id,
+        long long turn) {
+    pthread_mutex_unlock(handoff->mutexes + handoff->held_mutexes[thread_id]);
+    handoff->held_mutexes[thread_id] = turn % (handoff->thread_count + 1);
+}
+
+static void unlock_last_mutex(handoff_t* handoff, int thread_id) {
+    pthread_mutex_unlock(handoff->mutexes + handoff->held_mutexes[thread_id]);
+}
+
+static void destroy_mutex_ring(handoff_t* handoff) {
+    destroy_mutexes(handoff, handoff->thread_count + 1);
+}
+
+/*****************************************************************************
+ * Condition variables. The turn counter is guarded by one mutex,
+ * every thread waits on its own condition, so a handoff wakes up
+ * only the next thread.
+ ****************************************************************************/
+
+static void destroy_conditions(handoff_t* handoff, int count) {
+    for (int i = 0; i < count; ++i) {
+        pthread_cond_destroy(handoff->conditions + i);
+    }
+    free(handoff->conditions);
+    pthread_mutex_destroy(&handoff->mutex);
+}
+
+static int init_conditions(handoff_t* handoff) {
+    handoff->turn = 0;
+    handoff->conditions = (pthread_cond_t*)malloc(
+        handoff->thread_count * sizeof(pthread_cond_t));
+    if (handoff->conditions == NULL) {
+        return ENOMEM;
+    }
+    int code = pthread_mutex_init(&handoff->mutex, DEFAULT_ATTR);
+    if (code != SUCCESS) {
+        free(handoff->conditions);
+        return code;
+    }
+    for (int i = 0; i < handoff->thread_count; ++i) {
+        code = pthread_cond_init(handoff->conditions + i, DEFAULT_ATTR);
+        if (code != SUCCESS) {
+            destroy_conditions(handoff, i);
+            return code;
+        }
+    }
+    return SUCCESS;
+}
+
+static void wait_condition(handoff_t* handoff, int thread_id, long long turn) {
+    pthread_mutex_lock(&handoff->mutex);
+    while (handoff->turn != turn) {
+        pthread_cond_wait(handoff->conditions + thread_id, &handoff->mutex);
+    }
+    pthread_mutex_unlock(&handoff->mutex);
+}
+
+static void signal_condition(handoff_t* handoff, int thread_id, long long turn) {
+    pthread_mutex_lock(&handoff->mutex);
+    handoff->turn = turn + 1;
+    pthread_cond_signal(handoff->conditions + next_thread(handoff, thread_id));
+    pthread_mutex_unlock(&handoff->mutex);
+}
+
+static void destroy_condition_set(handoff_t* handoff) {
+    destroy_conditions(handoff, handoff->thread_count);
+}
+
+/*****************************************************************************
+ * Semaphores. Only the semaphore of the thread whose turn it is
+ * has a unit.
+ ****************************************************************************/
+
+static void destroy_semaphores(handoff_t* handoff, int count) {
+    for (int i = 0; i < count; ++i) {
+        sem_destroy((sem_t*) handoff->semaphores + i);
+    }
+    free(handoff->semaphores);
+}
+
+static int init_semaphores(handoff_t* handoff) {
+    sem_t* semaphores = (sem_t*)malloc(handoff->thread_count * sizeof(sem_t));
+    if (semaphores == NULL) {
+        return ENOMEM;
+    }
+    handoff->semaphores = semaphores;
+    for (int i = 0; i < handoff->thread_count; ++i) {
+        if (sem_init(semaphores + i, 0, i == 0 ? 1 : 0) != 0) {
+            int code = errno;
+            destroy_semaphores(handoff, i);
+            return code;
+        }
+    }
+    return SUCCESS;
+}
+
+static void wait_semaphore(handoff_t* handoff, int thread_id, long long turn) {
+    while (sem_wait((sem_t*) handoff->semaphores + thread_id) != 0) {
+    }
+}
+
+static void post_semaphore(handoff_t* handoff, int thread_id, long long turn) {
+    sem_post((sem_t*) handoff->semaphores + next_thread(handoff, thread_id));
+}
+
+static void destroy_semaphore_set(handoff_t* handoff) {
+    destroy_semaphores(handoff, handoff->thread_count);
+}
+
+/*****************************************************************************
+ * Futex words. The word of the thread whose turn it is is WORD_READY.
+ ****************************************************************************/
+
+static int* word_of(handoff_t* handoff, int thread_id) {
+    return handoff->words + thread_id * WORD_STRIDE;
+}
+
+static int init_words(handoff_t* handoff) {
+    void* words = NULL;
+    int code = posix_memalign(&words, CACHE_LINE_SIZE,
+                              handoff->thread_count * CACHE_LINE_SIZE);
+    if (code != SUCCESS) {
+        return code;
+    }
+    handoff->words = (int*) words;
+    for (int i = 0; i < handoff->thread_count; ++i) {
+        *word_of(handoff, i) = i == 0 ? WORD_READY : WORD_WAITING;
+    }
+    return SUCCESS;
+}
+
+/*
+ * The waiter sleeps while its word is WORD_WAITING, the kernel
+ * rechecks the word, so a wake between the load and the wait is
+ * not lost.
+ */
+static void wait_word(handoff_t* handoff, int thread_id, long long turn) {
+    int* word = word_of(handoff, thread_id);
+    while (__atomic_load_n(word, __ATOMIC_ACQUIRE) != WORD_READY) {
+        futex_wait(word, WORD_WAITING);
+    }
+    __atomic_store_n(word, WORD_WAITING, __ATOMIC_RELAXED);
+}
+
+static void wake_word(handoff_t* handoff, int thread_id, long long turn) {
+    int* word = word_of(handoff, next_thread(handoff, thread_id));
+    __atomic_store_n(word, WORD_READY, __ATOMIC_RELEASE);
+    futex_wake(word, 1);
+}
+
+/*
+ * Spin, then park. The waiter polls its word for spin_count rounds and
+ * only then announces that it parks by moving the word to WORD_PARKED.
+ * The waker makes a system call only if it sees WORD_PARKED.
+ */
+static void spin_or_park(handoff_t* handoff, int thread_id, long long turn) {
+    int* word = word_of(handoff, thread_id);
+    for (int i = 0; i < handoff->spin_count; ++i) {
+        if (__atomic_load_n(word, __ATOMIC_ACQUIRE) == WORD_READY) {
+            __atomic_store_n(word, WORD_WAITING, __ATOMIC_RELAXED);
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    int expected = WORD_WAITING;
+    if (__atomic_compare_exchange_n(word, &expected, WORD_PARKED, 0,
+            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(word, __ATOMIC_ACQUIRE) != WORD_READY) {
+            futex_wait(word, WORD_PARKED);
+        }
+    }
+    __atomic_store_n(word, WORD_WAITING, __ATOMIC_RELAXED);
+}
+
+static void wake_if_parked(handoff_t* handoff, int thread_id, long long turn) {
+    int* word = word_of(handoff, next_thread(handoff, thread_id));
+    if (__atomic_exchange_n(word, WORD_READY, __ATOMIC_RELEASE) == WORD_PARKED) {
+        futex_wake(word, 1);
+    }
+}
+
+/*
+ * On a single CPU the thread that is waited for can not run while
+ * the waiter spins, so the waiter parks at once.
+ */
+static int init_spinning_words(handoff_t* handoff) {
+    handoff->spin_count = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_COUNT : 0;
+    return init_words(handoff);
+}
+
+static void destroy_words(handoff_t* handoff) {
+    free(handoff->words);
+}
+
+/*****************************************************************************
+ * Ordered turnstile from utils, which 10lab prints text with.
+ ****************************************************************************/
+
+static int init_turnstile(handoff_t* handoff) {
+    return turnstile_init(&handoff->turnstile, handoff->thread_count);
+}
+
+static void wait_turnstile(handoff_t* handoff, int thread_id, long long turn) {
+    turnstile_wait(&handoff->turnstile, thread_id);
+}
+
+static void pass_turnstile(handoff_t* handoff, int thread_id, long long turn) {
+    turnstile_pass(&handoff->turnstile, thread_id);
+}
+
+static void destroy_turnstile(handoff_t* handoff) {
+    turnstile_destroy(&handoff->turnstile);
+}
+
+/*****************************************************************************
+ * Benchmark.
+ ****************************************************************************/
+
+static const handoff_method_t METHODS[] = {
+    { "mutex", init_mutex_ring, lock_first_mutex, lock_turn_mutex,
+      unlock_previous_mutex, unlock_last_mutex, destroy_mutex_ring },
+    { "cond", init_conditions, nothing, wait_condition, signal_condition,
+      nothing, destroy_condition_set },
+    { "sem", init_semaphores, nothing, wait_semaphore, post_semaphore,
+      nothing, destroy_semaphore_set },
+    { "futex", init_words, nothing, wait_word, wake_word, nothing,
+      destroy_words },
+    { "spin", init_spinning_words, nothing, spin_or_park, wake_if_parked, nothing,
+      destroy_words },
+    { "turnstile", init_turnstile, nothing, wait_turnstile, pass_turnstile,
+      nothing, destroy_turnstile },
+};
+
+const handoff_method_t* handoff_find_method(const char* name) {
+    for (int i = 0; i < handoff_method_count(); ++i) {
+        if (strcmp(METHODS[i].name, name) == 0) {
+            return METHODS + i;
+        }
+    }
+    return NULL;
+}
+
+int handoff_method_count() {
+    return sizeof(METHODS) / sizeof(METHODS[0]);
+}
+
+const handoff_method_t* handoff_methods() {
+    return METHODS;
+}
+
+/*
+ * Thread takes turns thread_id, thread_id + n, ... Timestamps are
+ * written before the release and read after the acquire, so the
+ * method itself orders them.
+ */
+static void* take_turns(void* arg) {
+    handoff_thread_t* thread = (handoff_thread_t*) arg;
+    handoff_t* handoff = thread->handoff;
+    const handoff_method_t* method = thread->method;
+    int id = thread->thread_id;
+
+    method->prepare(handoff, id);
+    latch_count_down(thread->ready);
+    latch_wait(thread->start);
+    for (long long turn = id; turn < handoff->turn_count;
+            turn += handoff->thread_count) {
+        method->acquire(handoff, id, turn);
+        double now = get_time_in_seconds();
+        if (turn > 0) {
+            thread->latencies[turn - 1] = now - handoff->handoff_time;
+        }
+        if (handoff->last_turn != turn - 1) {
+            ++handoff->order_error_count;
+        }
+        handoff->last_turn = turn;
+        handoff->handoff_time = get_time_in_seconds();
+        method->release(handoff, id, turn);
+    }
+    method->finish(handoff, id);
+    return NO_RETURN_VALUE;
+}
+
+int handoff_run(const handoff_method_t* method, int thread_count,
+        long long turn_count, double* latencies, double* elapsed,
+        long long* order_error_count) {
+    handoff_t handoff;
+    handoff.thread_count = thread_count;
+    handoff.turn_count = turn_count;
+    handoff.last_turn = -1;
+    handoff.order_error_count = 0;
+    handoff.handoff_time = 0;
+    int code = method->init(&handoff);
+    if (code != SUCCESS) {
+        return code;
+    }
+
+    pthread_t threads[thread_count];
+    handoff_thread_t data[thread_count];
+    latch_t ready;
+    latch_t start;
+    latch_init(&ready, thread_count);
+    latch_init(&start, 1);
+    int started_count = 0;
+    for ( ; started_count < thread_count; ++started_count) {
+        handoff_thread_t* thread = data + started_count;
+        thread->handoff = &handoff;
+        thread->method = method;
+        thread->latencies = latencies;
+        thread->ready = &ready;
+        thread->start = &start;
+        thread->thread_id = started_count;
+        code = pthread_create(threads + started_count, DEFAULT_ATTR,
+                              take_turns, thread);
+        if (code != SUCCESS) {
+            break;
+        }
+    }
+    /* Started threads use the locals of the run, so they are released
+     * without turns and joined before it ends */
+    if (code != SUCCESS) {
+        handoff.turn_count = 0;
+        latch_count_down(&start);
+        for (int i = 0; i < started_count; ++i) {
+            pthread_join(threads[i], NO_RETURN_VALUE);
+        }
+        latch_destroy(&ready);
+        latch_destroy(&start);
+        method->destroy(&handoff);
+        return code;
+    }
+
+    latch_wait(&ready);
+    double start_time = get_time_in_seconds();
+    latch_count_down(&start);
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i], NO_RETURN_VALUE);
+    }
+    *elapsed = get_time_in_seconds() - start_time;
+    *order_error_count = handoff.order_error_count;
+    latch_destroy(&ready);
+    latch_destroy(&start);
+    method->destroy(&handoff);
+    return SUCCESS;
+}
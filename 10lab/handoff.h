@@ -0,0 +1,77 @@
+#ifndef handoff_h
+#define handoff_h
+
+#include <pthread.h>
+#include "../utils/turnstile.h"
+
+/*
+ * Shared state of a handoff benchmark. Turns 0, 1, 2, ... are taken by
+ * threads 0, 1, ..., thread_count - 1, 0, ... in strict order: a thread
+ * waits until the previous turn has handed execution over to it.
+ * Only the primitives of the method in use are initialized.
+ */
+typedef struct handoff_s {
+    int thread_count;
+    long long turn_count;
+    /* Mutex ring: thread_count + 1 mutexes, each thread holds one */
+    pthread_mutex_t* mutexes;
+    int* held_mutexes;
+    /* Condition variables: one mutex, a condition per thread */
+    pthread_mutex_t mutex;
+    pthread_cond_t* conditions;
+    long long turn;
+    /* Semaphores and futex words, one per thread */
+    void* semaphores;
+    int* words;
+    int spin_count;
+    turnstile_t turnstile;
+    /* Time the last turn handed over and the last turn taken */
+    double handoff_time;
+    long long last_turn;
+    long long order_error_count;
+} handoff_t;
+
+/*
+ * Synchronization method. acquire() blocks thread_id until turn is
+ * its own, release() hands execution over to the next thread.
+ * prepare() and finish() are called by every thread before its first
+ * and after its last turn.
+ */
+typedef struct handoff_method_s {
+    const char* name;
+    int (*init)(handoff_t* handoff);
+    void (*prepare)(handoff_t* handoff, int thread_id);
+    void (*acquire)(handoff_t* handoff, int thread_id, long long turn);
+    void (*release)(handoff_t* handoff, int thread_id, long long turn);
+    void (*finish)(handoff_t* handoff, int thread_id);
+    void (*destroy)(handoff_t* handoff);
+} handoff_method_t;
+
+/*
+ * Function returns method with name or NULL: "mutex" (the ring
+ * of error-checking mutexes 10lab used to print text in turns), "cond",
+ * "sem", "futex", "spin" (spin, then park on a futex) or "turnstile"
+ * (the ordered turnstile from utils).
+ */
+const handoff_method_t* handoff_find_method(const char* name);
+
+/*
+ * Function returns the number of methods, method i is
+ * handoff_methods()[i].
+ */
+int handoff_method_count();
+const handoff_method_t* handoff_methods();
+
+/*
+ * Function runs turn_count turns on thread_count threads, at least two,
+ * with method. Latency of the handoff to turn i, from the release of
+ * turn i - 1 until turn i starts, is stored in latencies[i - 1]; the time
+ * from the start of the first turn until all threads finish is stored
+ * in elapsed. Turns taken out of order are counted in order_error_count.
+ * Returns SUCCESS or error code.
+ */
+int handoff_run(const handoff_method_t* method, int thread_count,
+        long long turn_count, double* latencies, double* elapsed,
+        long long* order_error_count);
+
+#endif /* handoff_h */
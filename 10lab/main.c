@@ -1,33 +1,59 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include <pthread.h>
 #include "../utils/util.h"
+#include "../utils/turnstile.h"
+#include "handoff.h"
+#include "ordered_output.h"
+#include "spawn.h"
 
-const int MUTEX_COUNT = 3;
 const int LINES_COUNT = 10;
-const int NO_INITIALIZED_MUTEXES = 0;
+const int THREAD_COUNT = 2;
 
-const int PARENT_INITIAL_MUTEX_ID = 1;
-const int CHILD_INITIAL_MUTEX_ID = 0;
+const int PARENT_ID = 0;
+const int CHILD_ID = 1;
 
-pthread_mutex_t global_mutexes[MUTEX_COUNT];
+const int MIN_BENCHMARK_ARGS_COUNT = 3;
+const int MAX_BENCHMARK_ARGS_COUNT = 4;
+const int MIN_BENCHMARK_THREAD_COUNT = 2;
+const int BASE = 0;
+
+const int MIN_LINES_ARGS_COUNT = 3;
+const int MAX_LINES_ARGS_COUNT = 4;
+const unsigned int RING_CAPACITY = 4096;
+
+const int SPAWN_ARGS_COUNT = 3;
+const int SPAWN_ROUND_COUNT = 20;
+
+/*
+ * Parent and child print global_line_count lines each in turns,
+ * the parent goes first. With the turnstile they take turns at printf(),
+ * with rings line i of thread t is record 2 * i + t of the output.
+ */
+int global_line_count = LINES_COUNT;
+turnstile_t global_turnstile;
+ordered_output_t global_output;
+int global_write_code = SUCCESS;
 
 /*****************************************************************************
  * Cleanup data and cleanup routine.
  ****************************************************************************/
 
 typedef struct cleanup_data_s {
-    pthread_mutexattr_t* attributes;
-    size_t initialized_mutex_count;
+    turnstile_t* turnstile;
+    ordered_output_t* output;
 } cleanup_data_t;
 
 void cleanup_routine(void* arg) {
     cleanup_data_t* cleanup_data = (cleanup_data_t*) arg;
-    if (cleanup_data->attributes != NULL) {
-        pthread_mutexattr_destroy(cleanup_data->attributes);
+    if (cleanup_data->turnstile != NULL) {
+        turnstile_destroy(cleanup_data->turnstile);
     }
-    for (int i = 0; i < cleanup_data->initialized_mutex_count; ++i) {
-        pthread_mutex_destroy(global_mutexes + i);
+    if (cleanup_data->output != NULL) {
+        ordered_output_destroy(cleanup_data->output);
     }
 }
 
@@ -36,114 +62,372 @@ void cleanup_routine(void* arg) {
  ****************************************************************************/
 
 /*
- * Thread calling this function has to have mutex with
- * id = (initial_mutex_id + MUTEX_COUNT - 1) % MUTEX_COUNT
- * already locked.
- *
- * Function does (to - from) iterations. On the i-th iteration it locks
- * (initial_mutex_id + i) mutex, prints text and unlocks locked mutex with
- * id = (initial_mutex_id + i + MUTEX_COUNT - 1) % MUTEX_COUNT.
+ * Function prints lines [from, to), each one on its own turn
+ * of participant_id.
  */
-void print_text_synchronously(char* string, int initial_mutex_id, int from, int to) {
+void print_text_synchronously(char* string, int participant_id, int from, int to) {
     for (int i = from; i < to; ++i) {
-        int lock_id = (i + initial_mutex_id) % MUTEX_COUNT;
-        int unlock_id = (i + initial_mutex_id + MUTEX_COUNT - 1) % MUTEX_COUNT;
-
-        pthread_mutex_lock(global_mutexes + lock_id);
+        turnstile_wait(&global_turnstile, participant_id);
         printf("line %d from %s thread\n", i, string);
-        pthread_mutex_unlock(global_mutexes + unlock_id);
+        turnstile_pass(&global_turnstile, participant_id);
     }
 }
 
 void* thread_routine(void* arg) {
-    /*
-     * Lock this mutex to let parent know that this child thread has started
-     * its routine. Also print_text_synchronously() function needs one mutex
-     * to be locked before entering it.
-     */
-    pthread_mutex_lock(global_mutexes + 2);
+    print_text_synchronously((char*) arg, CHILD_ID, 0, global_line_count);
+    pthread_exit(NO_RETURN_VALUE);
+}
 
-    /*
-     * The mutex 2 is already locked (needed by the function contract).
-     */
-    print_text_synchronously((char*) arg, CHILD_INITIAL_MUTEX_ID, 0, LINES_COUNT);
+/*
+ * Function appends source to text of length and returns the new length.
+ */
+int append_text(char* text, int length, const char* source) {
+    while (*source != '\0' && length < ORDERED_OUTPUT_RECORD_SIZE - 1) {
+        text[length++] = *source++;
+    }
+    return length;
+}
+
+/*
+ * Function writes the same line as printf() in print_text_synchronously()
+ * to text and returns its length; snprintf() alone would cost more than
+ * everything else a line takes in the ring.
+ */
+int format_line(char* text, int line, const char* string) {
+    char digits[16];
+    char* digit = digits + sizeof(digits) - 1;
+    *digit = '\0';
+    do {
+        *--digit = (char)('0' + line % 10);
+        line /= 10;
+    } while (line != 0);
+    int length = append_text(text, 0, "line ");
+    length = append_text(text, length, digit);
+    length = append_text(text, length, " from ");
+    length = append_text(text, length, string);
+    length = append_text(text, length, " thread\n");
+    text[length] = '\0';
+    return length;
+}
+
+/*
+ * Function puts lines [from, to) of participant_id into its ring
+ * without waiting for the other thread.
+ */
+void print_text_to_ring(char* string, int participant_id, int from, int to) {
+    for (int i = from; i < to; ++i) {
+        char* text = ordered_output_reserve(&global_output, participant_id);
+        int length = format_line(text, i, string);
+        ordered_output_commit(&global_output, participant_id,
+                              (long long) i * THREAD_COUNT + participant_id, length);
+    }
+}
+
+void* ring_thread_routine(void* arg) {
+    print_text_to_ring((char*) arg, CHILD_ID, 0, global_line_count);
+    pthread_exit(NO_RETURN_VALUE);
+}
+
+void* writer_routine(void* arg) {
+    global_write_code = ordered_output_write(&global_output,
+        (long long) global_line_count * THREAD_COUNT);
     pthread_exit(NO_RETURN_VALUE);
 }
 
 /*****************************************************************************
- * Initializing mutexes.
+ * Handoff benchmark. The threads only pass the turn to each other,
+ * nothing is printed, so only synchronization is measured.
  ****************************************************************************/
 
+int compare_latencies(const void* left, const void* right) {
+    double difference = *(const double*) left - *(const double*) right;
+    return (difference > 0) - (difference < 0);
+}
+
 /*
- * Initializing MUTEX_COUNT error-check type mutexes.
+ * Function returns the latency that fraction of sorted latencies
+ * does not exceed.
  */
-int initialize_mutexes(cleanup_data_t* cleanup_data) {
-    pthread_mutexattr_t attributes;
-    int code = pthread_mutexattr_init(&attributes);
+double percentile(double* latencies, long long count, double fraction) {
+    long long index = (long long)(fraction * count + 0.5) - 1;
+    if (index < 0) {
+        index = 0;
+    }
+    return latencies[index < count ? index : count - 1];
+}
+
+int run_method(const handoff_method_t* method, int thread_count,
+        long long handoff_count, double* latencies) {
+    double elapsed;
+    long long order_error_count;
+    int code = handoff_run(method, thread_count, handoff_count + 1, latencies,
+                           &elapsed, &order_error_count);
     if (code != SUCCESS) {
-        exit_with_custom_message("Unable to initialize mutex attributes object", code);
+        log_error("Unable to run benchmark", code);
+        return code;
+    }
+    qsort(latencies, handoff_count, sizeof(double), compare_latencies);
+    printf("%-9s %11.0f %9.2f %9.2f %9.2f %9.2f %11.2f\n", method->name,
+        handoff_count / elapsed,
+        percentile(latencies, handoff_count, 0.5) * 1e6,
+        percentile(latencies, handoff_count, 0.9) * 1e6,
+        percentile(latencies, handoff_count, 0.99) * 1e6,
+        percentile(latencies, handoff_count, 0.999) * 1e6,
+        latencies[handoff_count - 1] * 1e6);
+    if (order_error_count != 0) {
+        fprintf(stderr, "%s: %lld turns taken out of order\n", method->name,
+            order_error_count);
     }
-    cleanup_data->attributes = &attributes;
-    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_ERRORCHECK);
+    return SUCCESS;
+}
 
-    for (int i = 0; i < MUTEX_COUNT; ++i) {
-        code = pthread_mutex_init(global_mutexes + i, &attributes);
-        if (code != SUCCESS) {
-            log_error("Unable to initialize mutex", code);
-            return FAILURE;
+/*
+ * Function passes handoff_count turns around thread_count threads with
+ * the method given, or with every method, and prints handoffs per
+ * second and latency percentiles in microseconds.
+ */
+int run_benchmark(int argc, char* argv[]) {
+    char* end_pointer;
+    int thread_count = strtol(argv[1], &end_pointer, BASE);
+    if (*end_pointer != '\0' || thread_count < MIN_BENCHMARK_THREAD_COUNT) {
+        fprintf(stderr, "Thread count must be at least 2\n");
+        return EINVAL;
+    }
+    long long handoff_count = strtoll(argv[2], &end_pointer, BASE);
+    if (*end_pointer != '\0' || handoff_count <= 0) {
+        fprintf(stderr, "Handoff count must be a positive number\n");
+        return EINVAL;
+    }
+    const handoff_method_t* methods = handoff_methods();
+    int method_count = handoff_method_count();
+    if (argc == MAX_BENCHMARK_ARGS_COUNT) {
+        methods = handoff_find_method(argv[3]);
+        method_count = 1;
+        if (methods == NULL) {
+            fprintf(stderr, "Method must be one of mutex, cond, sem, futex, "
+                "spin, turnstile\n");
+            return EINVAL;
         }
-        cleanup_data->initialized_mutex_count = i + 1;
     }
+
+    double* latencies = (double*)malloc(handoff_count * sizeof(double));
+    if (latencies == NULL) {
+        log_error("Unable to allocate latencies", ENOMEM);
+        return ENOMEM;
+    }
+    printf("threads = %d, handoffs = %lld\n", thread_count, handoff_count);
+    printf("method     handoffs/s   p50 us    p90 us    p99 us  p99.9 us      max us\n");
+    int code = SUCCESS;
+    for (int i = 0; i < method_count && code == SUCCESS; ++i) {
+        code = run_method(methods + i, thread_count, handoff_count, latencies);
+    }
+    free(latencies);
+    return code;
+}
+
+/*****************************************************************************
+ * Spawn benchmark.
+ ****************************************************************************/
+
+int print_spawn_latencies(int thread_count, double* create_latencies,
+        double* release_latencies) {
+    double all_ready_time;
+    int code = spawn_run(thread_count, SPAWN_ROUND_COUNT, create_latencies,
+                         release_latencies, &all_ready_time);
+    if (code != SUCCESS) {
+        log_error("Unable to run spawn benchmark", code);
+        return code;
+    }
+    long long count = (long long) thread_count * SPAWN_ROUND_COUNT;
+    qsort(create_latencies, count, sizeof(double), compare_latencies);
+    qsort(release_latencies, count, sizeof(double), compare_latencies);
+    printf("%7d %10.2f %10.2f %12.2f %12.2f %12.2f\n", thread_count,
+        percentile(create_latencies, count, 0.5) * 1e6,
+        create_latencies[count - 1] * 1e6, all_ready_time * 1e6,
+        percentile(release_latencies, count, 0.5) * 1e6,
+        release_latencies[count - 1] * 1e6);
     return SUCCESS;
 }
 
-int main() {
-    cleanup_data_t cleanup_data;
-    int code = initialize_mutexes(&cleanup_data);
+/*
+ * Function starts 1, 2, 4, ... up to max_thread_count threads and
+ * prints in microseconds how long threads take from pthread_create()
+ * to running, until all of them are ready and from the opening of the
+ * start latch until they pass it.
+ */
+int run_spawn(char* argv[]) {
+    char* end_pointer;
+    int max_thread_count = strtol(argv[2], &end_pointer, BASE);
+    if (*end_pointer != '\0' || max_thread_count <= 0) {
+        fprintf(stderr, "Thread count must be a positive number\n");
+        return EINVAL;
+    }
+    long long count = (long long) max_thread_count * SPAWN_ROUND_COUNT;
+    double* create_latencies = (double*)malloc(count * sizeof(double));
+    double* release_latencies = (double*)malloc(count * sizeof(double));
+    if (create_latencies == NULL || release_latencies == NULL) {
+        free(create_latencies);
+        free(release_latencies);
+        log_error("Unable to allocate latencies", ENOMEM);
+        return ENOMEM;
+    }
+    printf("rounds = %d\n", SPAWN_ROUND_COUNT);
+    printf("%7s %10s %10s %12s %12s %12s\n", "threads", "start p50",
+        "start max", "all ready", "release p50", "release max");
+    int code = SUCCESS;
+    for (int thread_count = 1; code == SUCCESS; thread_count *= 2) {
+        if (thread_count > max_thread_count) {
+            thread_count = max_thread_count;
+        }
+        code = print_spawn_latencies(thread_count, create_latencies,
+                                     release_latencies);
+        if (thread_count == max_thread_count) {
+            break;
+        }
+    }
+    free(create_latencies);
+    free(release_latencies);
+    return code;
+}
+
+/*****************************************************************************
+ * Printing text.
+ ****************************************************************************/
+
+void print_with_turnstile(cleanup_data_t* cleanup_data) {
+    int code = turnstile_init(&global_turnstile, THREAD_COUNT);
     if (code != SUCCESS) {
-        exit_with_cleanup(code, cleanup_routine, (void*) &cleanup_data);
+        log_error("Unable to initialize turnstile", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
     }
+    cleanup_data->turnstile = &global_turnstile;
 
     /*
-     * Lock this mutex to make sure that child won't start printing  before
-     * parent. Child's first string will only be printed when child locks
-     * 0 and 2 mutex. Need this mutex to be locked to enter the
-     * print_text_synchronously() function.
+     * The child may start at any moment: its first line waits
+     * for the first line of the parent in the turnstile.
      */
-    pthread_mutex_lock(global_mutexes + 0);
-
     pthread_t child_thread;
     code = pthread_create(&child_thread, DEFAULT_ATTR, thread_routine, (void*) "child");
-
-    /*
-     * If there is an error in creating child thread we unlock all locked
-     * mutexes, free all resources and terminate the process.
-     */
     if (code != SUCCESS) {
-        pthread_mutex_unlock(global_mutexes + 0);
         log_error("Unable to start thread", code);
-        exit_with_cleanup(code, cleanup_routine, (void*) &cleanup_data);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
     }
 
+    print_text_synchronously("parent", PARENT_ID, 0, global_line_count);
 
-    /*
-     * This cycle makes sure that child thread started its routine.
-     */
-    while (!pthread_mutex_trylock(global_mutexes + 2)) {
-        pthread_mutex_unlock(global_mutexes + 2);
+    code = pthread_join(child_thread, NO_ARG);
+    if (code != SUCCESS) {
+        log_error("Unable to join thread", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
     }
+    fflush(stdout);
+}
 
-    /*
-     * Calling function with second argument PARENT_INITIAL_MUTEX_ID.
-     * The mutex 0 is already locked (needed by the function contract).
-     */
-    print_text_synchronously("parent", PARENT_INITIAL_MUTEX_ID, 0, LINES_COUNT);
+/*
+ * Parent and child fill their rings independently, a writer thread
+ * merges the lines in the order of the turnstile and writes them
+ * to stdout with writev().
+ */
+void print_with_rings(cleanup_data_t* cleanup_data) {
+    fflush(stdout);
+    int code = ordered_output_init(&global_output, STDOUT_FILENO, THREAD_COUNT,
+                                   RING_CAPACITY);
+    if (code != SUCCESS) {
+        log_error("Unable to initialize output", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
+    }
+    cleanup_data->output = &global_output;
+
+    pthread_t writer_thread;
+    code = pthread_create(&writer_thread, DEFAULT_ATTR, writer_routine, NO_ARG);
+    if (code != SUCCESS) {
+        log_error("Unable to start writer thread", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
+    }
+    pthread_t child_thread;
+    code = pthread_create(&child_thread, DEFAULT_ATTR, ring_thread_routine, (void*) "child");
+    if (code != SUCCESS) {
+        log_error("Unable to start thread", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
+    }
+
+    print_text_to_ring("parent", PARENT_ID, 0, global_line_count);
 
     code = pthread_join(child_thread, NO_ARG);
+    if (code == SUCCESS) {
+        code = pthread_join(writer_thread, NO_ARG);
+    }
     if (code != SUCCESS) {
         log_error("Unable to join thread", code);
-        exit_with_cleanup(code, cleanup_routine, (void*) &cleanup_data);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
+    }
+    if (global_write_code != SUCCESS) {
+        log_error("Unable to write output", global_write_code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) cleanup_data);
+    }
+}
+
+/*
+ * Function prints line_count lines from each thread with the method
+ * given, turnstile by default, and reports lines per second to stderr.
+ */
+void run_lines(int argc, char* argv[], cleanup_data_t* cleanup_data) {
+    char* end_pointer;
+    global_line_count = strtol(argv[2], &end_pointer, BASE);
+    if (*end_pointer != '\0' || global_line_count <= 0) {
+        exit_with_custom_message("Line count must be a positive number",
+            EXIT_FAILURE);
+    }
+    int use_rings = argc == MAX_LINES_ARGS_COUNT && strcmp(argv[3], "rings") == 0;
+    if (argc == MAX_LINES_ARGS_COUNT && !use_rings
+            && strcmp(argv[3], "turnstile") != 0) {
+        exit_with_custom_message("Method must be one of turnstile, rings",
+            EXIT_FAILURE);
+    }
+
+    double start_time = get_time_in_seconds();
+    if (use_rings) {
+        print_with_rings(cleanup_data);
+    } else {
+        print_with_turnstile(cleanup_data);
+    }
+    double elapsed = get_time_in_seconds() - start_time;
+    long long total_line_count = (long long) global_line_count * THREAD_COUNT;
+    fprintf(stderr, "%s: %lld lines, %.3f s, %.0f lines/s", use_rings
+        ? "rings" : "turnstile", total_line_count, elapsed,
+        total_line_count / elapsed);
+    if (use_rings) {
+        fprintf(stderr, ", %lld writev calls", global_output.writev_count);
+    }
+    fprintf(stderr, "\n");
+}
+
+/*
+ * Without arguments the program prints text from two threads in turns.
+ * With --lines <line_count> [turnstile|rings] each thread prints
+ * line_count lines, either in turns or through ordered rings.
+ * With --spawn <max_thread_count> it benchmarks thread startup.
+ * With <thread_count> <handoff_count> [method] it benchmarks handoffs.
+ */
+int main(int argc, char* argv[]) {
+    cleanup_data_t cleanup_data = { NULL, NULL };
+    if (argc == SPAWN_ARGS_COUNT && strcmp(argv[1], "--spawn") == 0) {
+        return run_spawn(argv) == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc >= MIN_LINES_ARGS_COUNT && argc <= MAX_LINES_ARGS_COUNT
+            && strcmp(argv[1], "--lines") == 0) {
+        run_lines(argc, argv, &cleanup_data);
+        exit_with_cleanup(SUCCESS, cleanup_routine, (void*) &cleanup_data);
+    }
+    if (argc >= MIN_BENCHMARK_ARGS_COUNT && argc <= MAX_BENCHMARK_ARGS_COUNT) {
+        return run_benchmark(argc, argv) == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc != 1) {
+        exit_with_custom_message("Usage: <program_name> [--lines <line_count> "
+            "[turnstile|rings] | --spawn <max_thread_count> | <thread_count> "
+            "<handoff_count> [mutex|cond|sem|futex|spin|turnstile]]", EXIT_FAILURE);
     }
 
+    print_with_turnstile(&cleanup_data);
     exit_with_cleanup(SUCCESS, cleanup_routine, (void*) &cleanup_data);
 }
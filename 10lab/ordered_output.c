@@ -0,0 +1,247 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include "../utils/util.h"
+#include "../utils/futex.h"
+#include "ordered_output.h"
+
+/*
+ * Lines are copied into segments of the batch, never split between two
+ * of them, and the whole batch is written with one writev(). Writing
+ * every record from its ring slot with a vector of its own costs the
+ * kernel more per line than the copy.
+ */
+#define SEGMENT_SIZE 65536
+#define SEGMENT_COUNT 4
+
+int ordered_output_init(ordered_output_t* output, int fd, int producer_count,
+        unsigned int ring_capacity) {
+    void* rings = NULL;
+    int code = posix_memalign(&rings, CACHE_LINE_SIZE,
+                              producer_count * sizeof(record_ring_t));
+    if (code != SUCCESS) {
+        return code;
+    }
+    output->batch = (char*)malloc(SEGMENT_COUNT * SEGMENT_SIZE);
+    if (output->batch == NULL) {
+        free(rings);
+        return ENOMEM;
+    }
+    output->rings = (record_ring_t*) rings;
+    output->fd = fd;
+    output->producer_count = producer_count;
+    output->writer_parked = 0;
+    output->writev_count = 0;
+    for (int i = 0; i < producer_count; ++i) {
+        record_ring_t* ring = output->rings + i;
+        void* records = NULL;
+        code = posix_memalign(&records, CACHE_LINE_SIZE,
+                              ring_capacity * sizeof(record_t));
+        if (code != SUCCESS) {
+            output->producer_count = i;
+            ordered_output_destroy(output);
+            return code;
+        }
+        ring->records = (record_t*) records;
+        ring->head = 0;
+        ring->tail = 0;
+        ring->read = 0;
+        ring->mask = ring_capacity - 1;
+        ring->producer_parked = 0;
+    }
+    return SUCCESS;
+}
+
+/*****************************************************************************
+ * Producers. A producer announces that it parks and only then checks
+ * the ring once more, the writer gives records back and only then looks
+ * for a parked producer, the same for the writer waiting for a record.
+ * Both sides are sequentially consistent, so a wakeup is never lost.
+ ****************************************************************************/
+
+static int is_full(record_ring_t* ring) {
+    unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+    return ring->head - tail > ring->mask;
+}
+
+char* ordered_output_reserve(ordered_output_t* output, int producer_id) {
+    record_ring_t* ring = output->rings + producer_id;
+    while (is_full(ring)) {
+        __atomic_store_n(&ring->producer_parked, 1, __ATOMIC_SEQ_CST);
+        if (!is_full(ring)) {
+            __atomic_store_n(&ring->producer_parked, 0, __ATOMIC_RELAXED);
+            break;
+        }
+        futex_wait(&ring->producer_parked, 1);
+    }
+    return ring->records[ring->head & ring->mask].text;
+}
+
+void ordered_output_commit(ordered_output_t* output, int producer_id,
+        long long sequence, int length) {
+    record_ring_t* ring = output->rings + producer_id;
+    record_t* record = ring->records + (ring->head & ring->mask);
+    record->sequence = sequence;
+    record->length = length;
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&output->writer_parked, __ATOMIC_SEQ_CST) != 0
+            && __atomic_exchange_n(&output->writer_parked, 0, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(&output->writer_parked, 1);
+    }
+}
+
+/*****************************************************************************
+ * Writer.
+ ****************************************************************************/
+
+/*
+ * Function returns the ring whose first unread record is sequence,
+ * looking at ring first_ring first, or NULL.
+ */
+static record_ring_t* find_record(ordered_output_t* output, long long sequence,
+        int first_ring) {
+    for (int i = 0; i < output->producer_count; ++i) {
+        record_ring_t* ring = output->rings
+            + (first_ring + i) % output->producer_count;
+        unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+        if (head != ring->read
+                && ring->records[ring->read & ring->mask].sequence == sequence) {
+            return ring;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function writes all of vectors, continuing after partial writes.
+ */
+static int write_vectors(ordered_output_t* output, struct iovec* vectors,
+        int count) {
+    while (count > 0) {
+        ssize_t written = writev(output->fd, vectors, count);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            return errno;
+        }
+        ++output->writev_count;
+        while (count > 0 && (size_t) written >= vectors->iov_len) {
+            written -= vectors->iov_len;
+            ++vectors;
+            --count;
+        }
+        if (count > 0) {
+            vectors->iov_base = (char*) vectors->iov_base + written;
+            vectors->iov_len -= written;
+        }
+    }
+    return SUCCESS;
+}
+
+/*
+ * Function gives records copied out back to their producers.
+ */
+static void give_back_records(ordered_output_t* output) {
+    for (int i = 0; i < output->producer_count; ++i) {
+        record_ring_t* ring = output->rings + i;
+        if (ring->tail == ring->read) {
+            continue;
+        }
+        __atomic_store_n(&ring->tail, ring->read, __ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&ring->producer_parked, 0, __ATOMIC_SEQ_CST) != 0) {
+            futex_wake(&ring->producer_parked, 1);
+        }
+    }
+}
+
+/*
+ * Function writes segments [0, count) of batch, segment i filled
+ * to sizes[i] bytes, skipping empty ones.
+ */
+static int write_batch(ordered_output_t* output, int* sizes, int count) {
+    struct iovec vectors[SEGMENT_COUNT];
+    int vector_count = 0;
+    for (int i = 0; i < count; ++i) {
+        if (sizes[i] > 0) {
+            vectors[vector_count].iov_base = output->batch + i * SEGMENT_SIZE;
+            vectors[vector_count].iov_len = sizes[i];
+            ++vector_count;
+        }
+    }
+    return write_vectors(output, vectors, vector_count);
+}
+
+/*
+ * Function waits until record sequence is published and returns its ring.
+ */
+static record_ring_t* wait_record(ordered_output_t* output, long long sequence,
+        int ring_id) {
+    record_ring_t* ring = find_record(output, sequence, ring_id);
+    while (ring == NULL) {
+        __atomic_store_n(&output->writer_parked, 1, __ATOMIC_SEQ_CST);
+        ring = find_record(output, sequence, ring_id);
+        if (ring != NULL) {
+            __atomic_store_n(&output->writer_parked, 0, __ATOMIC_RELAXED);
+            break;
+        }
+        futex_wait(&output->writer_parked, 1);
+        ring = find_record(output, sequence, ring_id);
+    }
+    return ring;
+}
+
+/*
+ * The batch is written out before the writer parks, so lines do not
+ * stay behind while producers are slow. After an error the writer keeps
+ * taking records without writing them, so producers do not block.
+ */
+int ordered_output_write(ordered_output_t* output, long long record_count) {
+    int code = SUCCESS;
+    int sizes[SEGMENT_COUNT] = { 0 };
+    int segment = 0;
+    int ring_id = 0;
+    for (long long sequence = 0; sequence < record_count; ++sequence) {
+        record_ring_t* ring = find_record(output, sequence, ring_id);
+        if (ring == NULL) {
+            give_back_records(output);
+            if (code == SUCCESS) {
+                code = write_batch(output, sizes, segment + 1);
+            }
+            segment = 0;
+            sizes[segment] = 0;
+            ring = wait_record(output, sequence, ring_id);
+        }
+        record_t* record = ring->records + (ring->read & ring->mask);
+        if (sizes[segment] + record->length > SEGMENT_SIZE) {
+            give_back_records(output);
+            if (++segment == SEGMENT_COUNT) {
+                if (code == SUCCESS) {
+                    code = write_batch(output, sizes, SEGMENT_COUNT);
+                }
+                segment = 0;
+            }
+            sizes[segment] = 0;
+        }
+        memcpy(output->batch + segment * SEGMENT_SIZE + sizes[segment],
+               record->text, record->length);
+        sizes[segment] += record->length;
+        ++ring->read;
+        /* Producers usually take turns, the next record is in the next ring */
+        ring_id = (ring - output->rings + 1) % output->producer_count;
+    }
+    give_back_records(output);
+    if (code == SUCCESS) {
+        code = write_batch(output, sizes, segment + 1);
+    }
+    return code;
+}
+
+void ordered_output_destroy(ordered_output_t* output) {
+    for (int i = 0; i < output->producer_count; ++i) {
+        free(output->rings[i].records);
+    }
+    free(output->rings);
+    free(output->batch);
+}
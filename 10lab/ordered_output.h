@@ -0,0 +1,82 @@
+#ifndef ordered_output_h
+#define ordered_output_h
+
+#include "../utils/util.h"
+
+/*
+ * Longest record including the terminating zero; sizeof(record_t)
+ * is two cache lines.
+ */
+#define ORDERED_OUTPUT_RECORD_SIZE 112
+
+typedef struct record_s {
+    long long sequence;
+    int length;
+    char text[ORDERED_OUTPUT_RECORD_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE))) record_t;
+
+/*
+ * Single-producer single-consumer ring of records. head counts records
+ * published by the producer, tail counts records the writer has copied
+ * out and given back. read counts records the writer has copied out,
+ * it is private to the writer. producer_parked is the futex word
+ * the producer sleeps on while the ring is full.
+ */
+typedef struct record_ring_s {
+    unsigned int head __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned int tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    int producer_parked;
+    unsigned int read;
+    unsigned int mask;
+    record_t* records;
+} __attribute__((aligned(CACHE_LINE_SIZE))) record_ring_t;
+
+/*
+ * Ordered output: producers put records numbered with a global sequence
+ * into their own rings without any lock, a single writer merges them
+ * by sequence into a batch of segments and writes the batch to fd with
+ * one writev(). Every producer must number its records in increasing
+ * order.
+ * writer_parked is the futex word the writer sleeps on while
+ * the next record has not been published yet.
+ */
+typedef struct ordered_output_s {
+    int writer_parked __attribute__((aligned(CACHE_LINE_SIZE)));
+    int fd;
+    int producer_count;
+    record_ring_t* rings;
+    char* batch;
+    long long writev_count;
+} ordered_output_t;
+
+/*
+ * Function initializes output to fd for producer_count producers with
+ * rings of ring_capacity records, a power of two.
+ * Returns SUCCESS or error code.
+ */
+int ordered_output_init(ordered_output_t* output, int fd, int producer_count,
+        unsigned int ring_capacity);
+
+/*
+ * Function blocks until the ring of producer_id has a free record and
+ * returns its text, ORDERED_OUTPUT_RECORD_SIZE bytes long.
+ */
+char* ordered_output_reserve(ordered_output_t* output, int producer_id);
+
+/*
+ * Function publishes the record reserved last by producer_id as record
+ * sequence of the output with length bytes of text.
+ */
+void ordered_output_commit(ordered_output_t* output, int producer_id,
+        long long sequence, int length);
+
+/*
+ * Function writes records 0, 1, ..., record_count - 1 in order as they
+ * are published. It is the writer and runs concurrently with the
+ * producers. Returns SUCCESS or error code of writev().
+ */
+int ordered_output_write(ordered_output_t* output, long long record_count);
+
+void ordered_output_destroy(ordered_output_t* output);
+
+#endif /* ordered_output_h */
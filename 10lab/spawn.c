@@ -0,0 +1,87 @@
+#include <pthread.h>
+#include "../utils/util.h"
+#include "../utils/latch.h"
+#include "spawn.h"
+
+typedef struct spawn_thread_s {
+    latch_t* ready;
+    latch_t* start;
+    double* release_time;
+    double create_time;
+    double* create_latency;
+    double* release_latency;
+} spawn_thread_t;
+
+static void* start_thread(void* arg) {
+    spawn_thread_t* thread = (spawn_thread_t*) arg;
+    *thread->create_latency = get_time_in_seconds() - thread->create_time;
+    latch_count_down(thread->ready);
+    latch_wait(thread->start);
+    *thread->release_latency = get_time_in_seconds() - *thread->release_time;
+    return NO_RETURN_VALUE;
+}
+
+/*
+ * Function runs one round, create_latencies and release_latencies
+ * point to the latencies of the round.
+ */
+static int run_round(int thread_count, double* create_latencies,
+        double* release_latencies, double* all_ready_time) {
+    pthread_t threads[thread_count];
+    spawn_thread_t data[thread_count];
+    latch_t ready;
+    latch_t start;
+    latch_init(&ready, thread_count);
+    latch_init(&start, 1);
+    double release_time = 0;
+
+    double first_create_time = get_time_in_seconds();
+    for (int i = 0; i < thread_count; ++i) {
+        spawn_thread_t* thread = data + i;
+        thread->ready = &ready;
+        thread->start = &start;
+        thread->release_time = &release_time;
+        thread->create_latency = create_latencies + i;
+        thread->release_latency = release_latencies + i;
+        thread->create_time = get_time_in_seconds();
+        int code = pthread_create(threads + i, DEFAULT_ATTR, start_thread, thread);
+        if (code != SUCCESS) {
+            /* Started threads use the locals of the round, so they are
+             * released and joined before it ends */
+            latch_count_down(&start);
+            for (int j = 0; j < i; ++j) {
+                pthread_join(threads[j], NO_RETURN_VALUE);
+            }
+            latch_destroy(&ready);
+            latch_destroy(&start);
+            return code;
+        }
+    }
+    latch_wait(&ready);
+    *all_ready_time = get_time_in_seconds() - first_create_time;
+    release_time = get_time_in_seconds();
+    latch_count_down(&start);
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i], NO_RETURN_VALUE);
+    }
+    latch_destroy(&ready);
+    latch_destroy(&start);
+    return SUCCESS;
+}
+
+int spawn_run(int thread_count, int round_count, double* create_latencies,
+        double* release_latencies, double* all_ready_time) {
+    double total_ready_time = 0;
+    for (int round = 0; round < round_count; ++round) {
+        double ready_time;
+        int offset = round * thread_count;
+        int code = run_round(thread_count, create_latencies + offset,
+                             release_latencies + offset, &ready_time);
+        if (code != SUCCESS) {
+            return code;
+        }
+        total_ready_time += ready_time;
+    }
+    *all_ready_time = total_ready_time / round_count;
+    return SUCCESS;
+}
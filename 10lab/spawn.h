@@ -0,0 +1,18 @@
+#ifndef spawn_h
+#define spawn_h
+
+/*
+ * Function starts thread_count threads round_count times. A thread counts
+ * down a ready latch as soon as it runs and then waits on a start latch,
+ * which is opened once all threads of the round are ready.
+ * For thread i of round r, the time from pthread_create() until the thread
+ * runs is stored in create_latencies[r * thread_count + i], the time from
+ * the opening of the start latch until the thread has passed it in
+ * release_latencies[r * thread_count + i]. The mean time from the first
+ * pthread_create() of a round until all its threads are ready is stored
+ * in all_ready_time. Returns SUCCESS or error code.
+ */
+int spawn_run(int thread_count, int round_count, double* create_latencies,
+        double* release_latencies, double* all_ready_time);
+
+#endif /* spawn_h */
@@ -0,0 +1,622 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <math.h>
+#include "../utils/util.h"
+#include "assembly_line.h"
+
+/*
+ * Function returns how many parts of stage its consumer takes for a part.
+ */
+static int input_quantity(const pipeline_t* pipeline, int stage_id) {
+    const stage_t* consumer = pipeline->stages + pipeline->stages[stage_id].consumer;
+    for (int i = 0; i < consumer->input_count; ++i) {
+        if (consumer->inputs[i].stage == stage_id) {
+            return consumer->inputs[i].quantity;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Function bounds the number of parts of every stage that exist at once,
+ * so pools of that size never run out. Up to buffer parts of a stage wait
+ * for the consumer or are being made and the rest are components of parts
+ * of the consumer. Products exist only while they are being made.
+ * Returns SUCCESS or ENOMEM if a bound does not fit an int.
+ */
+static int count_max_parts(const pipeline_t* pipeline, int batch_size,
+        int* counts) {
+    for (int i = pipeline->stage_count - 1; i >= 0; --i) {
+        const stage_t* stage = pipeline->stages + i;
+        long long count = (long long) stage->workers * batch_size;
+        if (stage->consumer >= 0) {
+            count = stage->buffer + (long long) input_quantity(pipeline, i)
+                    * counts[stage->consumer];
+        }
+        if (count > INT_MAX) {
+            return ENOMEM;
+        }
+        counts[i] = (int) count;
+    }
+    return SUCCESS;
+}
+
+/*
+ * Every worker of every stage has at most one batch in production.
+ */
+static int max_completion_count(const pipeline_t* pipeline) {
+    int count = 0;
+    for (int i = 0; i < pipeline->stage_count; ++i) {
+        count += pipeline->stages[i].workers;
+    }
+    return count;
+}
+
+/*
+ * Function frees the first stage_count stages of line.
+ */
+static void destroy_stages(assembly_line_t* line, int stage_count) {
+    for (int i = 0; i < stage_count; ++i) {
+        free(line->stages[i].parts);
+        part_pool_destroy(line->pools + i);
+    }
+    free(line->stages);
+    free(line->pools);
+    free(line->completions);
+}
+
+static int init_stages(assembly_line_t* line) {
+    const pipeline_t* pipeline = line->pipeline;
+    int max_part_counts[MAX_STAGE_COUNT];
+    int code = count_max_parts(pipeline, line->batch_size, max_part_counts);
+    if (code != SUCCESS) {
+        return code;
+    }
+    line->stages = (stage_state_t*)calloc(pipeline->stage_count,
+                                          sizeof(stage_state_t));
+    line->pools = (part_pool_t*)calloc(pipeline->stage_count,
+                                       sizeof(part_pool_t));
+    line->completions = (completion_t*)malloc(max_completion_count(pipeline)
+                                              * sizeof(completion_t));
+    if (line->stages == NULL || line->pools == NULL || line->completions == NULL) {
+        destroy_stages(line, 0);
+        return ENOMEM;
+    }
+    for (int i = 0; i < pipeline->stage_count; ++i) {
+        code = part_pool_init(line->pools + i, pipeline, i, max_part_counts[i]);
+        /* Products leave the line as they are finished, with no buffer */
+        if (code == SUCCESS && pipeline->stages[i].consumer >= 0) {
+            line->stages[i].parts = (part_t**)malloc(pipeline->stages[i].buffer
+                                                     * sizeof(part_t*));
+            if (line->stages[i].parts == NULL) {
+                part_pool_destroy(line->pools + i);
+                code = ENOMEM;
+            }
+        }
+        if (code != SUCCESS) {
+            destroy_stages(line, i);
+            return code;
+        }
+    }
+    return SUCCESS;
+}
+
+int assembly_line_init(assembly_line_t* line, const pipeline_t* pipeline,
+        int flags, int batch_size) {
+    if (batch_size <= 0 || batch_size > MAX_BATCH_SIZE) {
+        return EINVAL;
+    }
+    line->pipeline = pipeline;
+    line->batch_size = batch_size;
+    line->completion_count = 0;
+    line->completion_order = 0;
+    line->use_time = (flags & LINE_USE_TIME) != 0;
+    line->verbose = (flags & LINE_VERBOSE) != 0;
+    line->measure_latency = (flags & LINE_MEASURE_LATENCY) != 0;
+    line->simulated = 0;
+    line->now = 0;
+    line->sampled_time = 0;
+    line->stopping = 0;
+    line->idle_count = 0;
+    line->error = SUCCESS;
+    int code = init_stages(line);
+    if (code != SUCCESS) {
+        return code;
+    }
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_mutex_init(&line->mutex, DEFAULT_ATTR);
+    pthread_cond_init(&line->changed, &attributes);
+    pthread_condattr_destroy(&attributes);
+    latch_init(&line->finished, 0);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+ * Completions: binary heap ordered by time, then by order.
+ ****************************************************************************/
+
+static int is_earlier(completion_t* left, completion_t* right) {
+    return left->time < right->time
+        || (left->time == right->time && left->order < right->order);
+}
+
+static void swap_completions(completion_t* left, completion_t* right) {
+    completion_t temporary = *left;
+    *left = *right;
+    *right = temporary;
+}
+
+static void push_completion(assembly_line_t* line, double time, part_t* batch) {
+    completion_t* heap = line->completions;
+    int index = line->completion_count++;
+    heap[index].time = time;
+    heap[index].order = line->completion_order++;
+    heap[index].batch = batch;
+    while (index > 0 && is_earlier(heap + index, heap + (index - 1) / 2)) {
+        swap_completions(heap + index, heap + (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+}
+
+static part_t* pop_completion(assembly_line_t* line) {
+    completion_t* heap = line->completions;
+    part_t* batch = heap[0].batch;
+    heap[0] = heap[--line->completion_count];
+    int index = 0;
+    while (1) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < line->completion_count && is_earlier(heap + left, heap + smallest)) {
+            smallest = left;
+        }
+        if (right < line->completion_count && is_earlier(heap + right, heap + smallest)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return batch;
+        }
+        swap_completions(heap + index, heap + smallest);
+        index = smallest;
+    }
+}
+
+/*****************************************************************************
+ * Making parts. Functions are called with the mutex locked.
+ ****************************************************************************/
+
+static double current_time(assembly_line_t* line) {
+    return line->simulated ? line->now : get_time_in_seconds();
+}
+
+static int min(int left, int right) {
+    return left < right ? left : right;
+}
+
+/*
+ * Function returns how many parts stage can start now: it is limited by
+ * batches of free workers of the stage, sets of input parts and room
+ * in the buffer.
+ */
+static int count_ready_parts(assembly_line_t* line, int stage_id) {
+    const stage_t* stage = line->pipeline->stages + stage_id;
+    stage_state_t* state = line->stages + stage_id;
+    int count = (stage->workers - state->busy) * line->batch_size;
+    if (stage->consumer >= 0) {
+        count = min(count, stage->buffer - state->available - state->running);
+    }
+    for (int i = 0; i < stage->input_count && count > 0; ++i) {
+        const stage_input_t* input = stage->inputs + i;
+        count = min(count, line->stages[input->stage].available / input->quantity);
+    }
+    return count;
+}
+
+/*
+ * Function returns a ready stage or -1. Stages closer to the products
+ * are tried first, so parts leave the line before new ones are started.
+ */
+static int find_ready_stage(assembly_line_t* line) {
+    for (int i = line->pipeline->stage_count - 1; i >= 0; --i) {
+        if (count_ready_parts(line, i) > 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Function wakes an idle worker if more than busy_count batches are
+ * ready to start: that many are taken by workers that are going to look
+ * for a stage anyway. Waking workers for nothing costs a context switch
+ * each. Stages share inputs with no other stage, so ready batches of
+ * different stages can all start.
+ */
+static void wake_idle_worker(assembly_line_t* line, int busy_count) {
+    if (line->idle_count == 0) {
+        return;
+    }
+    int ready_count = 0;
+    for (int i = 0; i < line->pipeline->stage_count; ++i) {
+        ready_count += (count_ready_parts(line, i) + line->batch_size - 1)
+                       / line->batch_size;
+        if (ready_count > busy_count) {
+            pthread_cond_signal(&line->changed);
+            return;
+        }
+    }
+}
+
+static void print_part(assembly_line_t* line, part_t* part) {
+    const pipeline_t* pipeline = line->pipeline;
+    const char* name = pipeline->stages[part->stage].name;
+    if (line->simulated) {
+        printf("[%.3f] ", line->now);
+    }
+    if (part->component_count == 0) {
+        printf("detail %s-%lld produced\n", name, part->id);
+        return;
+    }
+    printf("%s-%lld produced from (", name, part->id);
+    for (int i = 0; i < part->component_count; ++i) {
+        part_t* component = part->components[i];
+        printf("%s%s-%lld", i > 0 ? ", " : "",
+            pipeline->stages[component->stage].name, component->id);
+    }
+    printf(")\n");
+}
+
+/*
+ * Function appends part to the buffer of its stage. Parts in production
+ * have room reserved there, so the buffer never overflows.
+ */
+static void push_part(assembly_line_t* line, part_t* part) {
+    stage_state_t* state = line->stages + part->stage;
+    int buffer = line->pipeline->stages[part->stage].buffer;
+    int index = state->first + state->available;
+    state->parts[index < buffer ? index : index - buffer] = part;
+    state->available++;
+}
+
+/*
+ * Function removes the oldest part from the buffer of stage.
+ */
+static part_t* pop_part(assembly_line_t* line, int stage_id) {
+    stage_state_t* state = line->stages + stage_id;
+    part_t* part = state->parts[state->first];
+    if (++state->first == line->pipeline->stages[stage_id].buffer) {
+        state->first = 0;
+    }
+    state->available--;
+    return part;
+}
+
+static void record_latency(stage_state_t* state, part_t* product, double now) {
+    double latency = now - product->origin;
+    state->latency_sum += latency;
+    if (latency > state->max_latency) {
+        state->max_latency = latency;
+    }
+}
+
+/*
+ * Function puts finished batch into the buffer of its stage, or returns
+ * its parts to the pools with all their components if they are products.
+ */
+static void complete_batch(assembly_line_t* line, part_t* batch) {
+    const stage_t* stage = line->pipeline->stages + batch->stage;
+    stage_state_t* state = line->stages + batch->stage;
+    double now = line->measure_latency && stage->consumer < 0
+        ? current_time(line) : 0;
+    int count = 0;
+    part_t* next;
+    for (part_t* part = batch; part != NULL; part = next) {
+        next = part->next;
+        if (line->verbose) {
+            print_part(line, part);
+        }
+        if (stage->consumer >= 0) {
+            push_part(line, part);
+        } else {
+            if (line->measure_latency) {
+                record_latency(state, part, now);
+            }
+            part_pool_release(line->pools, part);
+        }
+        count++;
+    }
+    state->produced += count;
+    state->running -= count;
+    state->busy--;
+    if (state->available > state->metrics.peak_depth) {
+        state->metrics.peak_depth = state->available;
+    }
+    /* The worker completing the batch goes on looking for a stage */
+    wake_idle_worker(line, 1);
+}
+
+/*
+ * Function completes batches whose production time has ended.
+ */
+static void complete_due_batches(assembly_line_t* line) {
+    if (line->completion_count == 0) {
+        return;
+    }
+    double now = current_time(line);
+    while (line->completion_count > 0 && line->completions[0].time <= now) {
+        complete_batch(line, pop_completion(line));
+    }
+}
+
+/*
+ * Function spends microseconds of CPU time.
+ */
+static void work_for(double microseconds) {
+    if (microseconds <= 0) {
+        return;
+    }
+    double end_time = get_time_in_seconds() + microseconds * 1e-6;
+    while (get_time_in_seconds() < end_time) {
+    }
+}
+
+/*
+ * Function takes the components of part from the buffers of the inputs
+ * as it claims them, so parts are taken in the order they were claimed
+ * even by several workers of a stage.
+ */
+static void take_components(assembly_line_t* line, part_t* part) {
+    const stage_t* stage = line->pipeline->stages + part->stage;
+    part_t** components = part->components;
+    for (int i = 0; i < stage->input_count; ++i) {
+        const stage_input_t* input = stage->inputs + i;
+        for (int j = 0; j < input->quantity; ++j) {
+            *components++ = pop_part(line, input->stage);
+        }
+    }
+}
+
+/*
+ * Function assembles part of its components with the mutex unlocked.
+ */
+static void assemble_part(assembly_line_t* line, part_t* part,
+        double start_time) {
+    const stage_t* stage = line->pipeline->stages + part->stage;
+    if (line->measure_latency) {
+        part->origin = stage->input_count == 0 ? start_time : INFINITY;
+        for (int i = 0; i < part->component_count; ++i) {
+            if (part->components[i]->origin < part->origin) {
+                part->origin = part->components[i]->origin;
+            }
+        }
+    }
+    if (!line->simulated) {
+        work_for(stage->work);
+    }
+}
+
+/*
+ * Function claims inputs of stage and parts from its pool for a batch
+ * of up to batch_size parts at once, takes the claimed inputs and
+ * assembles the batch with the mutex unlocked.
+ */
+static void make_batch(assembly_line_t* line, int stage_id) {
+    const stage_t* stage = line->pipeline->stages + stage_id;
+    stage_state_t* state = line->stages + stage_id;
+    int count = min(count_ready_parts(line, stage_id), line->batch_size);
+    part_t* batch = part_pool_take(line->pools + stage_id, count);
+    if (batch == NULL) {
+        /* Pools are as large as the line can hold, see count_max_parts() */
+        line->error = ENOMEM;
+        line->stopping = 1;
+        pthread_cond_broadcast(&line->changed);
+        return;
+    }
+    for (part_t* part = batch; part != NULL; part = part->next) {
+        part->id = state->next_id++;
+        take_components(line, part);
+    }
+    state->running += count;
+    state->busy++;
+    /* Parts of other stages are as old as their oldest component */
+    double start_time = line->measure_latency && stage->input_count == 0
+        ? current_time(line) : 0;
+    wake_idle_worker(line, 0);
+    pthread_mutex_unlock(&line->mutex);
+
+    for (part_t* part = batch; part != NULL; part = part->next) {
+        assemble_part(line, part, start_time);
+    }
+
+    pthread_mutex_lock(&line->mutex);
+    if (line->use_time && stage->time > 0) {
+        push_completion(line, current_time(line) + stage->time * count, batch);
+    } else {
+        complete_batch(line, batch);
+    }
+}
+
+/*
+ * Function waits until another worker changes the line or the
+ * earliest production time ends.
+ */
+static void wait_for_change(assembly_line_t* line) {
+    line->idle_count++;
+    if (line->completion_count > 0) {
+        double time = line->completions[0].time;
+        struct timespec deadline;
+        deadline.tv_sec = (time_t) time;
+        deadline.tv_nsec = (long)((time - deadline.tv_sec) * 1e9);
+        pthread_cond_timedwait(&line->changed, &line->mutex, &deadline);
+    } else {
+        pthread_cond_wait(&line->changed, &line->mutex);
+    }
+    line->idle_count--;
+}
+
+static void run_stages(void* arg, pool_worker_t* worker) {
+    assembly_line_t* line = (assembly_line_t*) arg;
+    pthread_mutex_lock(&line->mutex);
+    while (!line->stopping) {
+        complete_due_batches(line);
+        int stage_id = find_ready_stage(line);
+        if (stage_id >= 0) {
+            make_batch(line, stage_id);
+        } else {
+            wait_for_change(line);
+        }
+    }
+    pthread_mutex_unlock(&line->mutex);
+}
+
+/*****************************************************************************
+ * Metrics.
+ ****************************************************************************/
+
+static int has_inputs(assembly_line_t* line, const stage_t* stage) {
+    for (int i = 0; i < stage->input_count; ++i) {
+        const stage_input_t* input = stage->inputs + i;
+        if (line->stages[input->stage].available < input->quantity) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Function splits duration between busy and free workers of every stage.
+ * Free workers wait for inputs first, then for room in the buffer.
+ */
+static void sample_stages(assembly_line_t* line, double duration) {
+    for (int i = 0; i < line->pipeline->stage_count; ++i) {
+        const stage_t* stage = line->pipeline->stages + i;
+        stage_state_t* state = line->stages + i;
+        double busy_share = (double) state->busy / stage->workers;
+        state->metrics.busy_time += duration * busy_share;
+        double free_time = duration * (1 - busy_share);
+        if (state->busy == stage->workers) {
+            continue;
+        }
+        if (!has_inputs(line, stage)) {
+            state->metrics.starved_time += free_time;
+        } else if (stage->consumer >= 0
+                && state->available + state->running >= stage->buffer) {
+            state->metrics.blocked_time += free_time;
+        } else {
+            state->metrics.ready_time += free_time;
+        }
+    }
+    line->sampled_time += duration;
+}
+
+void assembly_line_sample(assembly_line_t* line, double duration) {
+    pthread_mutex_lock(&line->mutex);
+    sample_stages(line, duration);
+    pthread_mutex_unlock(&line->mutex);
+}
+
+double assembly_line_get_metrics(assembly_line_t* line, stage_metrics_t* metrics) {
+    pthread_mutex_lock(&line->mutex);
+    for (int i = 0; i < line->pipeline->stage_count; ++i) {
+        stage_state_t* state = line->stages + i;
+        metrics[i] = state->metrics;
+        metrics[i].depth = state->available;
+        metrics[i].started = state->next_id;
+        metrics[i].produced = state->produced;
+    }
+    double sampled_time = line->sampled_time;
+    pthread_mutex_unlock(&line->mutex);
+    return sampled_time;
+}
+
+/*****************************************************************************
+ * Simulation.
+ ****************************************************************************/
+
+/*
+ * Every part takes at least one detail, and every detail stage makes
+ * a bounded number of parts at a time that take time, so the clock moves.
+ */
+static int check_detail_times(const pipeline_t* pipeline) {
+    for (int i = 0; i < pipeline->stage_count; ++i) {
+        const stage_t* stage = pipeline->stages + i;
+        if (stage->input_count == 0 && stage->time <= 0) {
+            fprintf(stderr, "Stage %s makes details in no time\n", stage->name);
+            return EINVAL;
+        }
+    }
+    return SUCCESS;
+}
+
+/*
+ * Discrete-event loop: all stages that are ready at the current time
+ * start, then the clock jumps to the earliest production time to end.
+ * Stages do not change between events, so sampling them at every
+ * event measures their time exactly.
+ */
+int assembly_line_simulate(assembly_line_t* line, double time) {
+    int code = check_detail_times(line->pipeline);
+    if (code != SUCCESS) {
+        return code;
+    }
+    line->simulated = 1;
+    line->use_time = 1;
+    pthread_mutex_lock(&line->mutex);
+    while (!line->stopping) {
+        complete_due_batches(line);
+        int stage_id = find_ready_stage(line);
+        if (stage_id >= 0) {
+            make_batch(line, stage_id);
+        } else if (line->completion_count > 0
+                && line->completions[0].time <= time) {
+            sample_stages(line, line->completions[0].time - line->now);
+            line->now = line->completions[0].time;
+        } else {
+            break;
+        }
+    }
+    if (!line->stopping) {
+        sample_stages(line, time - line->now);
+        line->now = time;
+    }
+    pthread_mutex_unlock(&line->mutex);
+    return line->error;
+}
+
+/*****************************************************************************
+ * Starting and stopping.
+ ****************************************************************************/
+
+void assembly_line_start(assembly_line_t* line, thread_pool_t* pool) {
+    latch_reset(&line->finished, pool->worker_count);
+    for (int i = 0; i < pool->worker_count; ++i) {
+        thread_pool_submit_to(pool, i, run_stages, (void*) line, &line->finished);
+    }
+}
+
+int assembly_line_stop(assembly_line_t* line) {
+    pthread_mutex_lock(&line->mutex);
+    line->stopping = 1;
+    pthread_cond_broadcast(&line->changed);
+    pthread_mutex_unlock(&line->mutex);
+    latch_wait(&line->finished);
+    return line->error;
+}
+
+/*
+ * Parts left in the line are freed with the pools.
+ */
+void assembly_line_destroy(assembly_line_t* line) {
+    destroy_stages(line, line->pipeline->stage_count);
+    latch_destroy(&line->finished);
+    pthread_cond_destroy(&line->changed);
+    pthread_mutex_destroy(&line->mutex);
+}
@@ -0,0 +1,156 @@
+#ifndef assembly_line_h
+#define assembly_line_h
+
+#include <pthread.h>
+#include "../utils/latch.h"
+#include "../utils/thread_pool.h"
+#include "pipeline.h"
+#include "part_pool.h"
+
+#define MAX_BATCH_SIZE 1024
+
+#define LINE_USE_TIME 1
+#define LINE_VERBOSE 2
+#define LINE_MEASURE_LATENCY 4
+
+/*
+ * Metrics of a stage. depth parts wait for the consumer, at most
+ * peak_depth of them at once. started parts were begun and produced
+ * finished. Sampled time is split by what the workers of the stage
+ * do: make parts, wait for input parts, wait for room in the buffer
+ * or wait for a thread while the stage is ready.
+ */
+typedef struct stage_metrics_s {
+    int depth;
+    int peak_depth;
+    long long started;
+    long long produced;
+    double busy_time;
+    double starved_time;
+    double blocked_time;
+    double ready_time;
+} stage_metrics_t;
+
+/*
+ * Run time state of a stage. parts holds the available finished parts
+ * waiting for the consumer from first on, wrapping around at buffer.
+ * The consumer pops them as it claims them, under the mutex like the
+ * rest of the state. running parts are being made by busy workers, each
+ * of them has room reserved in parts. Latencies of products, from the start of their oldest detail
+ * to their end, are summed in latency_sum if the line measures them.
+ */
+typedef struct stage_state_s {
+    part_t** parts;
+    int first;
+    int available;
+    int running;
+    int busy;
+    long long next_id;
+    long long produced;
+    double latency_sum;
+    double max_latency;
+    stage_metrics_t metrics;
+} stage_state_t;
+
+/*
+ * Batch of parts, linked by next, whose production time ends at time.
+ * order breaks ties, so batches finishing at the same time complete
+ * in the order they were started.
+ */
+typedef struct completion_s {
+    double time;
+    long long order;
+    part_t* batch;
+} completion_t;
+
+/*
+ * Assembly line making parts of pipeline on the workers of a thread pool,
+ * so the number of threads does not depend on the number of stages.
+ * A worker takes a stage that is ready under the mutex, taking its
+ * input parts in order and claiming room for its output, and assembles
+ * the part outside it. A stage is ready when one of its workers is not
+ * making a part, its inputs have enough parts and its buffer has room.
+ * A worker takes up to batch_size sets of input parts at once and passes
+ * the parts made of them to the consumer at once, taking the production
+ * time of all of them. Workers of a stage are slots for parts in
+ * production, not threads: any thread makes parts of any stage.
+ * Production time does not keep a worker busy: the part waits in
+ * completions until its time ends.
+ * Workers with no ready stage wait on changed. Parts of every stage are
+ * taken from its pool, which holds as many parts as the stage can have at
+ * once, and products go back to the pools with all their components.
+ * A simulated line runs on a single thread and a virtual clock, now:
+ * parts are made in no time and production times only move the clock.
+ */
+typedef struct assembly_line_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    const pipeline_t* pipeline;
+    stage_state_t* stages;
+    part_pool_t* pools;
+    completion_t* completions;
+    int completion_count;
+    long long completion_order;
+    int use_time;
+    int verbose;
+    int measure_latency;
+    int batch_size;
+    int simulated;
+    double now;
+    double sampled_time;
+    int stopping;
+    int idle_count;
+    int error;
+    latch_t finished;
+} assembly_line_t;
+
+/*
+ * Function initializes line for pipeline. flags are a combination of
+ * LINE_USE_TIME, without it parts take no production time, LINE_VERBOSE
+ * to print every finished part and LINE_MEASURE_LATENCY to sum latencies
+ * of products, which takes reading the clock for every batch of details
+ * and products. Workers make parts in batches of up to batch_size, which
+ * is at most MAX_BATCH_SIZE. Returns SUCCESS or error code.
+ */
+int assembly_line_init(assembly_line_t* line, const pipeline_t* pipeline,
+        int flags, int batch_size);
+
+/*
+ * Function makes every worker of pool run the line until it is stopped.
+ */
+void assembly_line_start(assembly_line_t* line, thread_pool_t* pool);
+
+/*
+ * Function stops the line and waits until workers leave it.
+ * Returns SUCCESS or the error that stopped the line earlier.
+ */
+int assembly_line_stop(assembly_line_t* line);
+
+/*
+ * Function runs the line on the calling thread in virtual time from
+ * now, 0 for a new line, until time seconds, the same way every time.
+ * Every stage without inputs must take production time, otherwise the
+ * clock may never move. Stages are sampled at every event.
+ * Returns SUCCESS, EINVAL if a detail stage takes no time or the error
+ * that stopped the line.
+ */
+int assembly_line_simulate(assembly_line_t* line, double time);
+
+/*
+ * Function adds duration seconds to the sampled time of every stage,
+ * split by what the workers of the stage do now.
+ */
+void assembly_line_sample(assembly_line_t* line, double duration);
+
+/*
+ * Function copies metrics of every stage to metrics and returns
+ * the sampled time.
+ */
+double assembly_line_get_metrics(assembly_line_t* line, stage_metrics_t* metrics);
+
+/*
+ * Function frees the line with all parts left in it.
+ */
+void assembly_line_destroy(assembly_line_t* line);
+
+#endif /* assembly_line_h */
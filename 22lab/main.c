@@ -2,38 +2,60 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
+#include <getopt.h>
 #include "../utils/util.h"
+#include "../utils/thread_pool.h"
+#include "pipeline.h"
+#include "assembly_line.h"
+#include "metrics.h"
 
 #define SEM_PRIVATE 0
 #define SEM_INIT_VALUE 0
-#define PRODUCER_COUNT 5
-#define A_DETAIL_TIMEOUT 1
-#define B_DETAIL_TIMEOUT 2
-#define C_DETAIL_TIMEOUT 3
-
-#define SEM_COUNT 4
-sem_t detail_a;
-sem_t detail_b;
-sem_t detail_c;
-sem_t module;
-
-typedef enum { RUNNING, STOPPED } program_state_t;
-program_state_t global_state = RUNNING;
-
-void set_global_state(program_state_t state) {
-    global_state = state;
-}
+#define BASE 10
+#define SAMPLE_INTERVAL_NS 1000000
+#define NS_PER_SECOND 1000000000
+
+/*
+ * The line 22lab was written for: A and B make a module,
+ * C and the module make a widget.
+ */
+static const char DEFAULT_PIPELINE[] =
+    "stage A time 1\n"
+    "stage B time 2\n"
+    "stage C time 3\n"
+    "stage module needs 1 A 1 B\n"
+    "stage widget needs 1 C 1 module\n";
+
+/*
+ * Posted by the SIGINT handler, the main thread stops the line.
+ */
+sem_t stop_requested;
+
+typedef struct options_s {
+    const char* config_path;
+    int thread_count;
+    int benchmark_duration;
+    double simulated_duration;
+    int batch_size;
+    double metrics_interval;
+    int measure_latency;
+    int quiet;
+} options_t;
+
+typedef struct cleanup_data_s {
+    sem_t* stop_requested;
+    thread_pool_t* pool;
+    assembly_line_t* line;
+} cleanup_data_t;
 
 void handle_signal(int signal_number) {
     if (signal_number == SIGINT) {
-        set_global_state(STOPPED);
-        sem_post(&detail_a);
-        sem_post(&detail_b);
-        sem_post(&detail_c);
-        sem_post(&module);
+        sem_post(&stop_requested);
     }
 }
 
@@ -45,146 +67,321 @@ int set_signal_handler() {
    return SUCCESS;
 }
 
+/*
+ * Workers are stopped before the line is freed: the pool
+ * finishes the tasks running the line first.
+ */
 void cleanup_routine(void* arg) {
-    sem_destroy(&detail_a);
-    sem_destroy(&detail_b);
-    sem_destroy(&detail_c);
-    sem_destroy(&module);
-}
-
-void* produce_simple_detail(const char* detail_name,
-        int producing_timeout, sem_t* detail) {
-    int detail_id = 0;
-    sleep(producing_timeout);
-    while (global_state == RUNNING) {
-        sem_post(detail);
-        printf("detail %s-%d produced\n", detail_name, detail_id);
-        detail_id++;
-        sleep(producing_timeout);
-    }
-    pthread_exit(NO_RETURN_VALUE);
-}
-
-void* produce_detail_a(void* arg) {
-    return produce_simple_detail("A", A_DETAIL_TIMEOUT, &detail_a);
+    cleanup_data_t* cleanup_data = (cleanup_data_t*) arg;
+    if (cleanup_data->line != NULL) {
+        assembly_line_stop(cleanup_data->line);
+    }
+    if (cleanup_data->pool != NULL) {
+        thread_pool_destroy(cleanup_data->pool);
+    }
+    if (cleanup_data->line != NULL) {
+        assembly_line_destroy(cleanup_data->line);
+    }
+    if (cleanup_data->stop_requested != NULL) {
+        sem_destroy(cleanup_data->stop_requested);
+    }
 }
 
-void* produce_detail_b(void* arg) {
-    return produce_simple_detail("B", B_DETAIL_TIMEOUT, &detail_b);
-}
+/*****************************************************************************
+ * Running the line.
+ ****************************************************************************/
 
-void* produce_detail_c(void* arg) {
-    return produce_simple_detail("C", C_DETAIL_TIMEOUT, &detail_c);
+/*
+ * Function blocks until SIGINT or, if seconds is positive,
+ * until seconds pass.
+ */
+void wait_for_stop(int seconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += seconds;
+    int code;
+    do {
+        code = seconds > 0 ? sem_timedwait(&stop_requested, &deadline)
+                           : sem_wait(&stop_requested);
+    } while (code != SUCCESS && errno == EINTR);
 }
 
-void* produce_module(void* arg) {
-    int detail_a_id = 0;
-    int detail_b_id = 0;
-    int module_id = 0;
-    sem_wait(&detail_a);
-    sem_wait(&detail_b);
-    while (global_state == RUNNING) {
-        sem_post(&module);
-        printf("module-%d produced from (A-%d, B-%d)\n",
-            module_id, detail_a_id, detail_b_id);
-        detail_a_id++;
-        detail_b_id++;
-        module_id++;
-        sem_wait(&detail_a);
-        sem_wait(&detail_b);
-    }
-    pthread_exit(NO_RETURN_VALUE);
+/*
+ * Function samples line every SAMPLE_INTERVAL_NS and dumps metrics
+ * every interval seconds to stderr, until SIGINT or, if seconds is
+ * positive, until seconds pass. Sampling takes the mutex of the line
+ * a thousand times a second, so workers hardly notice it.
+ */
+void watch_line(assembly_line_t* line, metrics_t* metrics, int seconds,
+        double interval) {
+    double start_time = get_time_in_seconds();
+    double sample_time = start_time;
+    double dump_time = start_time + interval;
+    while (1) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SAMPLE_INTERVAL_NS;
+        if (deadline.tv_nsec >= NS_PER_SECOND) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= NS_PER_SECOND;
+        }
+        if (sem_timedwait(&stop_requested, &deadline) == SUCCESS) {
+            return;
+        }
+        double now = get_time_in_seconds();
+        assembly_line_sample(line, now - sample_time);
+        sample_time = now;
+        /* The last metrics are dumped when the line stops */
+        if (seconds > 0 && now - start_time >= seconds) {
+            return;
+        }
+        if (now >= dump_time) {
+            metrics_dump(metrics, line, now - start_time, stderr);
+            dump_time += interval;
+        }
+    }
 }
 
-void* produce_widget(void* arg) {
-    int widget_id = 0;
-    int module_id = 0;
-    int detail_c_id = 0;
-    sem_wait(&detail_c);
-    sem_wait(&module);
-    while (global_state == RUNNING) {
-        printf("widget-%d produced from (C-%d, M-%d)\n",
-            widget_id, detail_c_id, module_id);
-        widget_id++;
-        detail_c_id++;
-        module_id++;
-        sem_wait(&detail_c);
-        sem_wait(&module);
-    }
-    pthread_exit(NO_RETURN_VALUE);
+/*
+ * Function prints parts made by every stage in elapsed seconds
+ * and latencies of products.
+ */
+void print_statistics(const pipeline_t* pipeline, assembly_line_t* line,
+        double elapsed) {
+    printf("%-*s %8s %12s %12s\n", STAGE_NAME_SIZE / 2, "stage", "workers",
+        "parts", "parts/s");
+    for (int i = 0; i < pipeline->stage_count; ++i) {
+        long long produced = line->stages[i].produced;
+        printf("%-*s %8d %12lld %12.2f%s\n", STAGE_NAME_SIZE / 2,
+            pipeline->stages[i].name, pipeline->stages[i].workers,
+            produced, produced / elapsed,
+            pipeline->stages[i].consumer < 0 ? "  product" : "");
+    }
+    for (int i = 0; i < pipeline->stage_count && line->measure_latency; ++i) {
+        stage_state_t* state = line->stages + i;
+        if (pipeline->stages[i].consumer < 0 && state->produced > 0) {
+            printf("%s latency: mean %.3f ms, max %.3f ms\n",
+                pipeline->stages[i].name,
+                state->latency_sum / state->produced * 1e3,
+                state->max_latency * 1e3);
+        }
+    }
 }
 
-int initialize_semaphore(sem_t* semaphore) {
-    int code = sem_init(semaphore, SEM_PRIVATE, SEM_INIT_VALUE);
+/*
+ * Function runs the line in virtual time on the main thread and prints
+ * parts made per second of factory time. With metrics they are dumped
+ * every interval of factory time and at the end.
+ */
+int simulate(const pipeline_t* pipeline, options_t* options) {
+    assembly_line_t line;
+    int flags = LINE_USE_TIME | LINE_MEASURE_LATENCY
+                | (options->quiet ? 0 : LINE_VERBOSE);
+    int code = assembly_line_init(&line, pipeline, flags, options->batch_size);
     if (code != SUCCESS) {
-        log_error("Unable to initialize semaphore", code);
+        log_error("Unable to initialize assembly line", code);
+        return code;
+    }
+    metrics_t metrics;
+    metrics_init(&metrics, 0);
+    double interval = options->metrics_interval > 0 ? options->metrics_interval
+                                                    : options->simulated_duration;
+    double start_time = get_time_in_seconds();
+    for (double time = 0; time < options->simulated_duration && code == SUCCESS;) {
+        time = time + interval < options->simulated_duration
+            ? time + interval : options->simulated_duration;
+        code = assembly_line_simulate(&line, time);
+        if (code == SUCCESS && options->metrics_interval > 0) {
+            metrics_dump(&metrics, &line, time, stderr);
+        }
     }
+    double elapsed = get_time_in_seconds() - start_time;
+    if (code != SUCCESS) {
+        log_error("Unable to simulate assembly line", code);
+    } else {
+        printf("simulated time = %.3f s, wall time = %.3f s\n",
+            options->simulated_duration, elapsed);
+        print_statistics(pipeline, &line, options->simulated_duration);
+    }
+    assembly_line_destroy(&line);
     return code;
 }
 
-int initialize_all_semaphores() {
-    sem_t* semaphores[SEM_COUNT] = {&detail_a, &detail_b, &detail_c, &module};
-    for (int i = 0; i < SEM_COUNT; ++i) {
-        int code = sem_init(semaphores[i], SEM_PRIVATE, SEM_INIT_VALUE);
-        if (code != SUCCESS) {
-            return code;
-        }
+/*****************************************************************************
+ * Options.
+ ****************************************************************************/
+
+int parse_positive_number(const char* text, int* number) {
+    char* end_pointer;
+    long value = strtol(text, &end_pointer, BASE);
+    if (*end_pointer != '\0' || value <= 0 || value > 1000000) {
+        return FAILURE;
     }
+    *number = (int) value;
     return SUCCESS;
 }
 
-int start_all_producers(pthread_t* producers,
-        void* (*tasks[])(void*), int producer_count) {
-    for (int i = 0; i < producer_count; ++i) {
-        int code = pthread_create(producers + i, DEFAULT_ATTR, tasks[i],
-            NO_ARG);
-        if (code != SUCCESS) {
-            return code;
-        }
-    }
-    return SUCCESS;
+void print_usage_and_exit() {
+    exit_with_custom_message("Usage: <program_name> [--config <file>] "
+        "[--threads <count>] [--benchmark <seconds> | --simulate <seconds>] "
+        "[--batch <size>] [--latency] [--metrics <seconds>] [--quiet]",
+        EXIT_FAILURE);
 }
 
-int join_all_producers(pthread_t* producers, int producer_count) {
-    int code = 0;
-    for (int i = 0; i < producer_count; ++i) {
-        code = pthread_join(producers[i], NO_RETURN_VALUE);
-        if (code != SUCCESS) {
-            return code;
+void parse_arg_or_exit_if_error(int argc, char* argv[], options_t* options) {
+    static const struct option long_options[] = {
+        { "config", required_argument, NULL, 'c' },
+        { "threads", required_argument, NULL, 't' },
+        { "benchmark", required_argument, NULL, 'b' },
+        { "simulate", required_argument, NULL, 's' },
+        { "batch", required_argument, NULL, 'k' },
+        { "latency", no_argument, NULL, 'l' },
+        { "metrics", required_argument, NULL, 'm' },
+        { "quiet", no_argument, NULL, 'q' },
+        { NULL, 0, NULL, 0 }
+    };
+    options->config_path = NULL;
+    options->thread_count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    options->benchmark_duration = 0;
+    options->simulated_duration = 0;
+    options->batch_size = 1;
+    options->metrics_interval = 0;
+    options->measure_latency = 0;
+    options->quiet = 0;
+
+    int option;
+    while ((option = getopt_long(argc, argv, "c:t:b:s:k:lm:q", long_options, NULL)) != -1) {
+        if (option == 'c') {
+            options->config_path = optarg;
+        } else if (option == 't') {
+            if (parse_positive_number(optarg, &options->thread_count) != SUCCESS) {
+                exit_with_custom_message("Thread count must be a positive number",
+                    EXIT_FAILURE);
+            }
+        } else if (option == 'b') {
+            if (parse_positive_number(optarg, &options->benchmark_duration)
+                    != SUCCESS) {
+                exit_with_custom_message("Benchmark duration must be "
+                    "a positive number of seconds", EXIT_FAILURE);
+            }
+        } else if (option == 's') {
+            char* end_pointer;
+            options->simulated_duration = strtod(optarg, &end_pointer);
+            if (*end_pointer != '\0' || options->simulated_duration <= 0) {
+                exit_with_custom_message("Simulated duration must be "
+                    "a positive number of seconds", EXIT_FAILURE);
+            }
+        } else if (option == 'k') {
+            if (parse_positive_number(optarg, &options->batch_size) != SUCCESS
+                    || options->batch_size > MAX_BATCH_SIZE) {
+                exit_with_custom_message("Batch size must be a positive number "
+                    "not greater than 1024", EXIT_FAILURE);
+            }
+        } else if (option == 'm') {
+            char* end_pointer;
+            options->metrics_interval = strtod(optarg, &end_pointer);
+            if (*end_pointer != '\0' || options->metrics_interval <= 0) {
+                exit_with_custom_message("Metrics interval must be "
+                    "a positive number of seconds", EXIT_FAILURE);
+            }
+        } else if (option == 'l') {
+            options->measure_latency = 1;
+        } else if (option == 'q') {
+            options->quiet = 1;
+        } else {
+            print_usage_and_exit();
         }
     }
-    return SUCCESS;
+    if (optind != argc
+            || (options->benchmark_duration > 0 && options->simulated_duration > 0)) {
+        print_usage_and_exit();
+    }
 }
 
-int main() {
-    int code = set_signal_handler();
+/*
+ * The line is read from --config or is the one of DEFAULT_PIPELINE.
+ * It runs on --threads workers, by default one per CPU, printing every
+ * part until SIGINT, unless --quiet. With --benchmark <seconds> parts
+ * take no production time and are not printed, and parts per second are
+ * reported. With --simulate <seconds> the line runs that much factory
+ * time on a virtual clock instead. With --batch <size> workers make
+ * up to size parts of a stage at once. Latencies of products are
+ * reported when simulating or with --latency. With --metrics <seconds>
+ * queue depths, stalls and parts in flight of every stage are printed
+ * to stderr that often and when the line stops.
+ */
+int main(int argc, char* argv[]) {
+    options_t options;
+    parse_arg_or_exit_if_error(argc, argv, &options);
+    int benchmark = options.benchmark_duration > 0;
+
+    static pipeline_t pipeline;
+    int code = options.config_path != NULL
+        ? pipeline_load(&pipeline, options.config_path)
+        : pipeline_parse(&pipeline, DEFAULT_PIPELINE, "default pipeline");
     if (code != SUCCESS) {
-        log_error("SIGINT handler was not set", code);
+        log_error("Unable to read pipeline", code);
+        exit(EXIT_FAILURE);
+    }
+    if (options.simulated_duration > 0) {
+        return simulate(&pipeline, &options) == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    code = initialize_all_semaphores();
+    cleanup_data_t cleanup_data = { NULL, NULL, NULL };
+    code = sem_init(&stop_requested, SEM_PRIVATE, SEM_INIT_VALUE);
     if (code != SUCCESS) {
-        log_error("Unable to initialize semaphore", code);
-        exit_with_cleanup(code, cleanup_routine, NO_ARG);
+        log_error("Unable to initialize semaphore", errno);
+        exit(EXIT_FAILURE);
     }
+    cleanup_data.stop_requested = &stop_requested;
 
-    void* (*tasks[PRODUCER_COUNT])(void* arg) = {
-        produce_detail_a, produce_detail_b, produce_detail_c,
-        produce_module, produce_widget
-    };
+    code = set_signal_handler();
+    if (code != SUCCESS) {
+        log_error("SIGINT handler was not set", code);
+    }
 
-    pthread_t producers[PRODUCER_COUNT];
-    code = start_all_producers(producers, tasks, PRODUCER_COUNT);
+    assembly_line_t line;
+    int flags = (benchmark ? 0 : LINE_USE_TIME)
+                | (benchmark || options.quiet ? 0 : LINE_VERBOSE)
+                | (options.measure_latency ? LINE_MEASURE_LATENCY : 0);
+    code = assembly_line_init(&line, &pipeline, flags, options.batch_size);
     if (code != SUCCESS) {
-        log_error("Unable to start producers", code);
-        exit_with_cleanup(code, cleanup_routine, NO_ARG);
+        log_error("Unable to initialize assembly line", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) &cleanup_data);
     }
+    thread_pool_t pool;
+    code = thread_pool_init(&pool, options.thread_count);
+    if (code != SUCCESS) {
+        log_error("Unable to start workers", code);
+        assembly_line_destroy(&line);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) &cleanup_data);
+    }
+    cleanup_data.pool = &pool;
 
-    code = join_all_producers(producers, PRODUCER_COUNT);
+    double start_time = get_time_in_seconds();
+    assembly_line_start(&line, &pool);
+    cleanup_data.line = &line;
+    metrics_t metrics;
+    metrics_init(&metrics, 0);
+    if (options.metrics_interval > 0) {
+        watch_line(&line, &metrics, options.benchmark_duration,
+                   options.metrics_interval);
+    } else {
+        wait_for_stop(options.benchmark_duration);
+    }
+    code = assembly_line_stop(&line);
+    double elapsed = get_time_in_seconds() - start_time;
+    if (options.metrics_interval > 0) {
+        metrics_dump(&metrics, &line, elapsed, stderr);
+    }
     if (code != SUCCESS) {
-        log_error("Unable to join producers", code);
-        exit_with_cleanup(code, cleanup_routine, NO_ARG);
+        log_error("Assembly line stopped", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, (void*) &cleanup_data);
     }
 
-    exit_with_cleanup(SUCCESS, cleanup_routine, NO_ARG);
+    if (benchmark) {
+        printf("threads = %d, time = %.3f s\n", options.thread_count, elapsed);
+        print_statistics(&pipeline, &line, elapsed);
+    }
+    exit_with_cleanup(SUCCESS, cleanup_routine, (void*) &cleanup_data);
 }
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+#include "../utils/util.h"
+#include "metrics.h"
+
+#define PERCENT 100
+
+void metrics_init(metrics_t* metrics, double time) {
+    metrics->time = time;
+    memset(metrics->produced, 0, sizeof(metrics->produced));
+}
+
+/*
+ * Function finds for every stage the product its parts end up in and how
+ * many of its parts one product holds. Consumers are defined after their
+ * inputs, so going backwards they are counted first.
+ */
+static void count_parts_per_product(const pipeline_t* pipeline, int* products,
+        long long* counts) {
+    for (int i = pipeline->stage_count - 1; i >= 0; --i) {
+        int consumer_id = pipeline->stages[i].consumer;
+        if (consumer_id < 0) {
+            products[i] = i;
+            counts[i] = 1;
+            continue;
+        }
+        const stage_t* consumer = pipeline->stages + consumer_id;
+        for (int j = 0; j < consumer->input_count; ++j) {
+            if (consumer->inputs[j].stage == i) {
+                counts[i] = consumer->inputs[j].quantity * counts[consumer_id];
+            }
+        }
+        products[i] = products[consumer_id];
+    }
+}
+
+static double share(double time, double sampled_time) {
+    return sampled_time > 0 ? PERCENT * time / sampled_time : 0;
+}
+
+/*
+ * Parts go back to their pools only with their product, when it is
+ * finished, so parts in flight are found from counters without walking
+ * the line. Pools take the same memory all the time.
+ */
+void metrics_dump(metrics_t* metrics, assembly_line_t* line, double time,
+        FILE* stream) {
+    const pipeline_t* pipeline = line->pipeline;
+    stage_metrics_t stages[MAX_STAGE_COUNT];
+    double sampled_time = assembly_line_get_metrics(line, stages);
+    int products[MAX_STAGE_COUNT];
+    long long counts[MAX_STAGE_COUNT];
+    count_parts_per_product(pipeline, products, counts);
+
+    double elapsed = time - metrics->time;
+    long long total_in_flight = 0;
+    size_t total_bytes = 0;
+    size_t pool_bytes = 0;
+    fprintf(stream, "metrics at %.3f s\n", time);
+    fprintf(stream, "%-*s %8s %8s %12s %8s %8s %8s %8s %10s\n",
+        STAGE_NAME_SIZE / 2, "stage", "depth", "peak", "parts/s", "busy%",
+        "starved%", "blocked%", "ready%", "in flight");
+    for (int i = 0; i < pipeline->stage_count; ++i) {
+        stage_metrics_t* stage = stages + i;
+        long long freed = stages[products[i]].produced * counts[i];
+        long long in_flight = stage->started - freed;
+        total_in_flight += in_flight;
+        total_bytes += in_flight * part_size(pipeline, i);
+        pool_bytes += line->pools[i].capacity * line->pools[i].part_size;
+        fprintf(stream, "%-*s %8d %8d %12.2f %8.1f %8.1f %8.1f %8.1f %10lld\n",
+            STAGE_NAME_SIZE / 2, pipeline->stages[i].name, stage->depth,
+            stage->peak_depth,
+            elapsed > 0 ? (stage->produced - metrics->produced[i]) / elapsed : 0,
+            share(stage->busy_time, sampled_time),
+            share(stage->starved_time, sampled_time),
+            share(stage->blocked_time, sampled_time),
+            share(stage->ready_time, sampled_time), in_flight);
+        metrics->produced[i] = stage->produced;
+    }
+    fprintf(stream, "parts in flight = %lld, bytes = %zu of %zu in pools\n",
+        total_in_flight, total_bytes, pool_bytes);
+    metrics->time = time;
+}
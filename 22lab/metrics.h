@@ -0,0 +1,32 @@
+#ifndef metrics_h
+#define metrics_h
+
+#include <stdio.h>
+#include "pipeline.h"
+#include "assembly_line.h"
+
+/*
+ * Metrics of a line as of the last dump, so parts per second are
+ * reported for the time since then.
+ */
+typedef struct metrics_s {
+    double time;
+    long long produced[MAX_STAGE_COUNT];
+} metrics_t;
+
+/*
+ * Function starts counting parts per second at time.
+ */
+void metrics_init(metrics_t* metrics, double time);
+
+/*
+ * Function prints to stream at time, for every stage of line: parts
+ * waiting for the consumer now and at most, parts per second since the
+ * last dump, shares of the sampled time its workers were busy, starved
+ * of inputs, blocked by a full buffer or ready without a thread, and
+ * parts in flight with the bytes they take of the pools.
+ */
+void metrics_dump(metrics_t* metrics, assembly_line_t* line, double time,
+        FILE* stream);
+
+#endif /* metrics_h */
@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <errno.h>
+#include "../utils/util.h"
+#include "part_pool.h"
+
+int part_pool_init(part_pool_t* pool, const pipeline_t* pipeline, int stage,
+        int capacity) {
+    pool->part_size = part_size(pipeline, stage);
+    pool->memory = (char*)malloc((size_t) capacity * pool->part_size);
+    if (pool->memory == NULL) {
+        return ENOMEM;
+    }
+    pool->free_parts = NULL;
+    pool->free_count = capacity;
+    pool->used_count = 0;
+    pool->capacity = capacity;
+    pool->stage = stage;
+    pool->component_count = pipeline->stages[stage].component_count;
+    return SUCCESS;
+}
+
+/*
+ * Function returns a released part or else a part never taken before.
+ */
+static part_t* take_part(part_pool_t* pool) {
+    part_t* part = pool->free_parts;
+    if (part != NULL) {
+        pool->free_parts = part->next;
+        return part;
+    }
+    part = (part_t*)(pool->memory + (size_t) pool->used_count++ * pool->part_size);
+    /* Parts never change stage, so only their ids are set when taken */
+    part->stage = pool->stage;
+    part->component_count = pool->component_count;
+    return part;
+}
+
+part_t* part_pool_take(part_pool_t* pool, int count) {
+    if (count > pool->free_count || count <= 0) {
+        return NULL;
+    }
+    pool->free_count -= count;
+    part_t* parts = take_part(pool);
+    part_t* last = parts;
+    for (int i = 1; i < count; ++i) {
+        last->next = take_part(pool);
+        last = last->next;
+    }
+    last->next = NULL;
+    return parts;
+}
+
+void part_pool_release(part_pool_t* pools, part_t* part) {
+    for (int i = 0; i < part->component_count; ++i) {
+        part_pool_release(pools, part->components[i]);
+    }
+    part_pool_t* pool = pools + part->stage;
+    part->next = pool->free_parts;
+    pool->free_parts = part;
+    pool->free_count++;
+}
+
+void part_pool_destroy(part_pool_t* pool) {
+    free(pool->memory);
+}
@@ -0,0 +1,49 @@
+#ifndef part_pool_h
+#define part_pool_h
+
+#include <stddef.h>
+#include "pipeline.h"
+
+/*
+ * Parts of one stage in a single block of memory allocated up front,
+ * so the pool never grows. Parts come from free_parts, linked by next,
+ * or from the used_count-th part on, which were never taken, so memory
+ * is touched only when the line needs it. The pool is not synchronized,
+ * callers take and release parts under their own lock.
+ */
+typedef struct part_pool_s {
+    part_t* free_parts;
+    int free_count;
+    int used_count;
+    int capacity;
+    int stage;
+    int component_count;
+    size_t part_size;
+    char* memory;
+} part_pool_t;
+
+/*
+ * Function allocates capacity parts of stage.
+ * Returns SUCCESS or ENOMEM.
+ */
+int part_pool_init(part_pool_t* pool, const pipeline_t* pipeline, int stage,
+        int capacity);
+
+/*
+ * Function takes count parts linked by next, ending with NULL.
+ * Returns NULL if fewer than count parts are free.
+ */
+part_t* part_pool_take(part_pool_t* pool, int count);
+
+/*
+ * Function returns part with all its components to pools,
+ * the pool of every stage at its index.
+ */
+void part_pool_release(part_pool_t* pools, part_t* part);
+
+/*
+ * Function frees pool with all its parts.
+ */
+void part_pool_destroy(part_pool_t* pool);
+
+#endif /* part_pool_h */
@@ -0,0 +1,229 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "../utils/util.h"
+#include "pipeline.h"
+
+#define SEPARATORS " \t\r"
+#define COMMENT '#'
+
+/*
+ * Function reports error at line of source and returns EINVAL.
+ */
+static int parse_error(const char* source, int line, const char* message,
+        const char* token) {
+    fprintf(stderr, "%s:%d: %s%s%s\n", source, line, message,
+        token != NULL ? ": " : "", token != NULL ? token : "");
+    return EINVAL;
+}
+
+static int parse_double(const char* token, double* value) {
+    char* end_pointer;
+    if (token == NULL) {
+        return FAILURE;
+    }
+    *value = strtod(token, &end_pointer);
+    return *end_pointer == '\0' && *value >= 0 ? SUCCESS : FAILURE;
+}
+
+static int parse_count(const char* token, int* value) {
+    char* end_pointer;
+    if (token == NULL) {
+        return FAILURE;
+    }
+    long count = strtol(token, &end_pointer, 10);
+    if (*end_pointer != '\0' || count <= 0 || count > 1000000) {
+        return FAILURE;
+    }
+    *value = (int) count;
+    return SUCCESS;
+}
+
+/*
+ * Function parses inputs of stage, pairs of a quantity and a stage
+ * defined earlier, from the tokens left on the line.
+ */
+static int parse_inputs(pipeline_t* pipeline, stage_t* stage, char** state,
+        const char* source, int line) {
+    char* token;
+    while ((token = strtok_r(NULL, SEPARATORS, state)) != NULL) {
+        if (stage->input_count == MAX_INPUT_COUNT) {
+            return parse_error(source, line, "Too many inputs", NULL);
+        }
+        stage_input_t* input = stage->inputs + stage->input_count;
+        if (parse_count(token, &input->quantity) != SUCCESS) {
+            return parse_error(source, line, "Invalid quantity", token);
+        }
+        char* name = strtok_r(NULL, SEPARATORS, state);
+        if (name == NULL) {
+            return parse_error(source, line, "Input expected after quantity", token);
+        }
+        input->stage = pipeline_find_stage(pipeline, name);
+        if (input->stage < 0) {
+            return parse_error(source, line, "Input is not defined before", name);
+        }
+        if (pipeline->stages[input->stage].consumer >= 0) {
+            return parse_error(source, line, "Input already has a consumer", name);
+        }
+        stage->component_count += input->quantity;
+        stage->input_count++;
+        /* Consumer is set right away, so an input can not be listed twice */
+        pipeline->stages[input->stage].consumer = pipeline->stage_count;
+    }
+    if (stage->input_count == 0) {
+        return parse_error(source, line, "Inputs expected after needs", NULL);
+    }
+    return SUCCESS;
+}
+
+static int parse_stage(pipeline_t* pipeline, char** state, const char* source,
+        int line) {
+    char* name = strtok_r(NULL, SEPARATORS, state);
+    if (name == NULL || strlen(name) >= STAGE_NAME_SIZE) {
+        return parse_error(source, line, "Stage name expected", name);
+    }
+    if (pipeline_find_stage(pipeline, name) >= 0) {
+        return parse_error(source, line, "Stage is already defined", name);
+    }
+    if (pipeline->stage_count == MAX_STAGE_COUNT) {
+        return parse_error(source, line, "Too many stages", NULL);
+    }
+    stage_t* stage = pipeline->stages + pipeline->stage_count;
+    memset(stage, 0, sizeof(stage_t));
+    strcpy(stage->name, name);
+    stage->buffer = DEFAULT_BUFFER_SIZE;
+    stage->workers = DEFAULT_WORKER_COUNT;
+    stage->consumer = -1;
+
+    char* key;
+    int code = SUCCESS;
+    while (code == SUCCESS && (key = strtok_r(NULL, SEPARATORS, state)) != NULL) {
+        if (strcmp(key, "needs") == 0) {
+            code = parse_inputs(pipeline, stage, state, source, line);
+            break;
+        }
+        char* value = strtok_r(NULL, SEPARATORS, state);
+        if (strcmp(key, "time") == 0) {
+            if (parse_double(value, &stage->time) != SUCCESS) {
+                code = parse_error(source, line, "Invalid time", value);
+            }
+        } else if (strcmp(key, "work") == 0) {
+            if (parse_double(value, &stage->work) != SUCCESS) {
+                code = parse_error(source, line, "Invalid work", value);
+            }
+        } else if (strcmp(key, "buffer") == 0) {
+            if (parse_count(value, &stage->buffer) != SUCCESS) {
+                code = parse_error(source, line, "Invalid buffer", value);
+            }
+        } else if (strcmp(key, "workers") == 0) {
+            if (parse_count(value, &stage->workers) != SUCCESS) {
+                code = parse_error(source, line, "Invalid workers", value);
+            }
+        } else {
+            code = parse_error(source, line, "Unknown key", key);
+        }
+    }
+    if (code != SUCCESS) {
+        return code;
+    }
+    for (int i = 0; i < stage->input_count; ++i) {
+        stage_input_t* input = stage->inputs + i;
+        if (input->quantity > pipeline->stages[input->stage].buffer) {
+            return parse_error(source, line, "Quantity exceeds buffer of input",
+                pipeline->stages[input->stage].name);
+        }
+    }
+    pipeline->stage_count++;
+    return SUCCESS;
+}
+
+static int parse_line(pipeline_t* pipeline, char* text, const char* source,
+        int line) {
+    char* comment = strchr(text, COMMENT);
+    if (comment != NULL) {
+        *comment = '\0';
+    }
+    char* state;
+    char* keyword = strtok_r(text, SEPARATORS, &state);
+    if (keyword == NULL) {
+        return SUCCESS;
+    }
+    if (strcmp(keyword, "stage") != 0) {
+        return parse_error(source, line, "Unknown keyword", keyword);
+    }
+    return parse_stage(pipeline, &state, source, line);
+}
+
+int pipeline_parse(pipeline_t* pipeline, const char* text, const char* source) {
+    char* copy = strdup(text);
+    if (copy == NULL) {
+        return ENOMEM;
+    }
+    pipeline->stage_count = 0;
+    int code = SUCCESS;
+    int line = 1;
+    for (char* next = copy; next != NULL && code == SUCCESS; ++line) {
+        char* end = strchr(next, '\n');
+        if (end != NULL) {
+            *end = '\0';
+        }
+        code = parse_line(pipeline, next, source, line);
+        next = end != NULL ? end + 1 : NULL;
+    }
+    free(copy);
+    if (code == SUCCESS && pipeline->stage_count == 0) {
+        code = parse_error(source, line - 1, "No stages defined", NULL);
+    }
+    return code;
+}
+
+int pipeline_load(pipeline_t* pipeline, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return errno;
+    }
+    size_t capacity = BUFSIZ;
+    size_t size = 0;
+    char* text = (char*)malloc(capacity);
+    int code = text != NULL ? SUCCESS : ENOMEM;
+    while (code == SUCCESS) {
+        size += fread(text + size, 1, capacity - size - 1, file);
+        if (size < capacity - 1) {
+            break;
+        }
+        capacity *= 2;
+        char* bigger = (char*)realloc(text, capacity);
+        if (bigger == NULL) {
+            code = ENOMEM;
+        }
+        text = bigger != NULL ? bigger : text;
+    }
+    if (code == SUCCESS && ferror(file)) {
+        code = EIO;
+    }
+    fclose(file);
+    if (code == SUCCESS) {
+        text[size] = '\0';
+        code = pipeline_parse(pipeline, text, path);
+    }
+    free(text);
+    return code;
+}
+
+int pipeline_find_stage(const pipeline_t* pipeline, const char* name) {
+    for (int i = 0; i < pipeline->stage_count; ++i) {
+        if (strcmp(pipeline->stages[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+size_t part_size(const pipeline_t* pipeline, int stage) {
+    return sizeof(part_t) + pipeline->stages[stage].component_count * sizeof(part_t*);
+}
+
@@ -0,0 +1,92 @@
+#ifndef pipeline_h
+#define pipeline_h
+
+#include <stddef.h>
+
+#define MAX_STAGE_COUNT 64
+#define MAX_INPUT_COUNT 8
+#define STAGE_NAME_SIZE 32
+#define DEFAULT_BUFFER_SIZE 64
+#define DEFAULT_WORKER_COUNT 1
+
+/*
+ * quantity parts made by stage are needed for one part of the consumer.
+ */
+typedef struct stage_input_s {
+    int stage;
+    int quantity;
+} stage_input_t;
+
+/*
+ * Stage makes parts named after it from parts of its inputs, a stage
+ * without inputs makes details. Making a part takes time seconds of
+ * production time and work microseconds of CPU time. Up to buffer
+ * finished parts wait for the consumer, the stage that takes them as
+ * an input; parts of a stage without consumer are products. Up to
+ * workers parts of the stage are made at the same time.
+ */
+typedef struct stage_s {
+    char name[STAGE_NAME_SIZE];
+    double time;
+    double work;
+    int buffer;
+    int workers;
+    int input_count;
+    stage_input_t inputs[MAX_INPUT_COUNT];
+    int component_count;
+    int consumer;
+} stage_t;
+
+/*
+ * Stages in the order they were defined: inputs of a stage are defined
+ * before it, so stages never form a cycle.
+ */
+typedef struct pipeline_s {
+    int stage_count;
+    stage_t stages[MAX_STAGE_COUNT];
+} pipeline_t;
+
+/*
+ * Part made by stage, the id-th one. It owns the parts it was
+ * assembled from, in the order of the inputs of the stage.
+ * origin is the time the oldest detail in it was started,
+ * next links parts finished together.
+ */
+typedef struct part_s {
+    int stage;
+    long long id;
+    double origin;
+    struct part_s* next;
+    int component_count;
+    struct part_s* components[];
+} part_t;
+
+/*
+ * Function reads pipeline from text, one stage per line:
+ *
+ *   stage <name> [time <seconds>] [work <microseconds>] [buffer <count>]
+ *         [workers <count>] [needs <quantity> <input> [<quantity> <input> ...]]
+ *
+ * Empty lines and text after '#' are ignored. Errors are reported
+ * to stderr with source and line number.
+ * Returns SUCCESS or EINVAL.
+ */
+int pipeline_parse(pipeline_t* pipeline, const char* text, const char* source);
+
+/*
+ * Function reads pipeline from file at path.
+ * Returns SUCCESS, EINVAL or error code of reading the file.
+ */
+int pipeline_load(pipeline_t* pipeline, const char* path);
+
+/*
+ * Function returns stage with name or -1.
+ */
+int pipeline_find_stage(const pipeline_t* pipeline, const char* name);
+
+/*
+ * Function returns the size in bytes of a part of stage.
+ */
+size_t part_size(const pipeline_t* pipeline, int stage);
+
+#endif /* pipeline_h */
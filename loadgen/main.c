@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../utils/util.h"
+
+const int EXPECTED_ARGS_COUNT = 3;
+const int BASE = 0;
+const double DEFAULT_MAX_TERM_COUNT = 1e8;
+const int DEFAULT_DISTINCT_COUNT = 16;
+const char* DEFAULT_SERIES = "pi";
+
+#define LINE_SIZE 64
+
+/*
+ * Load generator for the 08lab daemon (a.out --serve). Every client
+ * connects on its own thread and sends requests one after another,
+ * waiting for the reply to each. Term counts are drawn from
+ * distinct_count multiples of max_term_count / distinct_count, so the
+ * fewer distinct values there are, the more requests hit the cache.
+ * Latency of a request is the time from sending it until its reply
+ * is read.
+ */
+
+typedef struct options_s {
+    const char* socket_path;
+    int client_count;
+    int request_count;
+    const char* series_name;
+    double max_term_count;
+    int distinct_count;
+} options_t;
+
+typedef struct client_data_s {
+    int id;
+    options_t* options;
+    pthread_barrier_t* start;
+    double* latencies;
+    int error_count;
+    int code;
+} client_data_t;
+
+int connect_to_service(const char* path, int* fd) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return ENAMETOOLONG;
+    }
+    strcpy(address.sun_path, path);
+    *fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (*fd < 0) {
+        return errno;
+    }
+    if (connect(*fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+        int code = errno;
+        close(*fd);
+        return code;
+    }
+    return SUCCESS;
+}
+
+/*
+ * Function sends request line and reads the reply line into reply.
+ * Returns SUCCESS, EPIPE if the service has closed the connection
+ * or error code.
+ */
+int send_request(int fd, const char* request, char* reply) {
+    size_t length = strlen(request);
+    if (send(fd, request, length, MSG_NOSIGNAL) != (ssize_t) length) {
+        return errno != 0 ? errno : EPIPE;
+    }
+    size_t received = 0;
+    while (received == 0 || reply[received - 1] != '\n') {
+        ssize_t count = recv(fd, reply + received, LINE_SIZE - 1 - received, 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0 || received + count == LINE_SIZE - 1) {
+            return count < 0 ? errno : EPIPE;
+        }
+        received += count;
+    }
+    reply[received] = '\0';
+    return SUCCESS;
+}
+
+void* run_client(void* arg) {
+    client_data_t* data = (client_data_t*) arg;
+    options_t* options = data->options;
+    int fd = -1;
+    data->code = connect_to_service(options->socket_path, &fd);
+    pthread_barrier_wait(data->start);
+    if (data->code != SUCCESS) {
+        return NO_RETURN_VALUE;
+    }
+
+    unsigned int seed = data->id + 1;
+    char request[LINE_SIZE];
+    char reply[LINE_SIZE];
+    for (int i = 0; i < options->request_count; ++i) {
+        int value = rand_r(&seed) % options->distinct_count + 1;
+        long long term_count = (long long)(options->max_term_count * value /
+                                           options->distinct_count);
+        snprintf(request, sizeof(request), "%s %lld\n", options->series_name,
+                 term_count > 0 ? term_count : 1);
+        double start_time = get_time_in_seconds();
+        data->code = send_request(fd, request, reply);
+        if (data->code != SUCCESS) {
+            break;
+        }
+        data->latencies[i] = get_time_in_seconds() - start_time;
+        if (strncmp(reply, "error", strlen("error")) == 0) {
+            ++data->error_count;
+        }
+    }
+    close(fd);
+    return NO_RETURN_VALUE;
+}
+
+int compare_doubles(const void* left, const void* right) {
+    double difference = *(const double*) left - *(const double*) right;
+    return (difference > 0) - (difference < 0);
+}
+
+/*
+ * Function returns the latency that fraction of sorted latencies
+ * does not exceed.
+ */
+double percentile(double* latencies, int count, double fraction) {
+    int index = (int)(fraction * count + 0.5) - 1;
+    if (index < 0) {
+        index = 0;
+    }
+    return latencies[index < count ? index : count - 1];
+}
+
+void print_report(options_t* options, double* latencies, int error_count,
+        double elapsed) {
+    int count = options->client_count * options->request_count;
+    qsort(latencies, count, sizeof(double), compare_doubles);
+    printf("requests = %d\n", count);
+    printf("errors = %d\n", error_count);
+    printf("elapsed = %.3f s\n", elapsed);
+    printf("throughput = %.1f requests/s\n", count / elapsed);
+    printf("latency p50 = %.3f ms, p99 = %.3f ms, max = %.3f ms\n",
+        percentile(latencies, count, 0.5) * 1000,
+        percentile(latencies, count, 0.99) * 1000,
+        latencies[count - 1] * 1000);
+}
+
+/*****************************************************************************
+ * Cleanup data and cleanup routine.
+ ****************************************************************************/
+
+typedef struct cleanup_data_s {
+    double* latencies;
+    client_data_t* clients;
+    pthread_t* threads;
+} cleanup_data_t;
+
+void cleanup_routine(void* arg) {
+    cleanup_data_t* cleanup_data = (cleanup_data_t*) arg;
+    free(cleanup_data->latencies);
+    free(cleanup_data->clients);
+    free(cleanup_data->threads);
+}
+
+void print_usage() {
+    printf("Usage: <program_name> [-S series] [-n max_term_count] "
+        "[-d distinct_count] <socket_path> <client_count> "
+        "<requests_per_client>\n");
+}
+
+int parse_positive_number(const char* string_value, int* result) {
+    char* end_pointer;
+    errno = 0;
+    long value = strtol(string_value, &end_pointer, BASE);
+    if (errno == ERANGE || *end_pointer != '\0' || value <= 0 ||
+            value > 1000000000L) {
+        return EINVAL;
+    }
+    *result = (int) value;
+    return SUCCESS;
+}
+
+void parse_arg_or_exit_if_error(int argc, char *argv[], options_t* options) {
+    options->series_name = DEFAULT_SERIES;
+    options->max_term_count = DEFAULT_MAX_TERM_COUNT;
+    options->distinct_count = DEFAULT_DISTINCT_COUNT;
+
+    int option;
+    while ((option = getopt(argc, argv, "S:n:d:")) != -1) {
+        if (option == 'S') {
+            options->series_name = optarg;
+        } else if (option == 'n') {
+            char* end_pointer;
+            options->max_term_count = strtod(optarg, &end_pointer);
+            exit_if_true_with_message(*end_pointer != '\0' ||
+                options->max_term_count < 1, "Max term count must be \
+                    a positive number");
+        } else if (option == 'd') {
+            exit_if_true_with_message(parse_positive_number(optarg,
+                &options->distinct_count) != SUCCESS, "Distinct count must be \
+                    a positive number");
+        } else {
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (argc - optind != EXPECTED_ARGS_COUNT) {
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+    options->socket_path = argv[optind];
+    exit_if_true_with_message(parse_positive_number(argv[optind + 1],
+        &options->client_count) != SUCCESS, "Client count must be \
+            a positive number");
+    exit_if_true_with_message(parse_positive_number(argv[optind + 2],
+        &options->request_count) != SUCCESS, "Request count must be \
+            a positive number");
+}
+
+
+int main(int argc, char *argv[]) {
+    options_t options;
+    parse_arg_or_exit_if_error(argc, argv, &options);
+    int client_count = options.client_count;
+
+    cleanup_data_t cleanup_data;
+    cleanup_data.latencies = (double*)malloc(
+        (size_t) client_count * options.request_count * sizeof(double));
+    cleanup_data.clients = (client_data_t*)malloc(
+        client_count * sizeof(client_data_t));
+    cleanup_data.threads = (pthread_t*)malloc(client_count * sizeof(pthread_t));
+    if (cleanup_data.latencies == NULL || cleanup_data.clients == NULL ||
+            cleanup_data.threads == NULL) {
+        log_error("Unable to allocate client data", ENOMEM);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+    }
+
+    /* Requests are sent once all clients have connected */
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, client_count + 1);
+    int started_count = 0;
+    for (int i = 0; i < client_count; ++i) {
+        client_data_t* client = cleanup_data.clients + i;
+        client->id = i;
+        client->options = &options;
+        client->start = &start;
+        client->latencies = cleanup_data.latencies +
+            (size_t) i * options.request_count;
+        client->error_count = 0;
+        client->code = SUCCESS;
+        int code = pthread_create(cleanup_data.threads + i, DEFAULT_ATTR,
+                                  run_client, client);
+        if (code != SUCCESS) {
+            log_error("Unable to create client thread", code);
+            exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+        }
+        ++started_count;
+    }
+    pthread_barrier_wait(&start);
+    double start_time = get_time_in_seconds();
+
+    int error_count = 0;
+    int code = SUCCESS;
+    for (int i = 0; i < started_count; ++i) {
+        pthread_join(cleanup_data.threads[i], NO_RETURN_VALUE);
+        error_count += cleanup_data.clients[i].error_count;
+        if (cleanup_data.clients[i].code != SUCCESS) {
+            code = cleanup_data.clients[i].code;
+        }
+    }
+    double elapsed = get_time_in_seconds() - start_time;
+    pthread_barrier_destroy(&start);
+    if (code != SUCCESS) {
+        log_error("Client failed", code);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+    }
+    print_report(&options, cleanup_data.latencies, error_count, elapsed);
+    exit_with_cleanup(EXIT_SUCCESS, cleanup_routine, &cleanup_data);
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include "../utils/util.h"
+#include "../utils/telemetry.h"
+
+const int MIN_ARGS_COUNT = 2;
+const int MAX_ARGS_COUNT = 3;
+const double DEFAULT_INTERVAL = 1;
+
+/*
+ * Reader of the stats segment published by 07lab and 08lab.
+ * Every interval it prints iterations per second of every worker of the
+ * current run over the last interval, imbalance between threads and ETA of the run.
+ */
+
+typedef struct sample_s {
+    long long run_id;
+    int worker_count;
+    double time;
+    long long* iter_counts;
+} sample_t;
+
+/*
+ * Function loads counters of the workers of the current run. Every
+ * counter is read atomically, the run is read before and after the
+ * counters so that a sample spanning two runs is retaken.
+ */
+void take_sample(telemetry_t* telemetry, sample_t* sample) {
+    telemetry_header_t* header = telemetry->header;
+    long long run_id;
+    do {
+        run_id = __atomic_load_n(&header->run_id, __ATOMIC_ACQUIRE);
+        sample->worker_count = __atomic_load_n(&header->worker_count,
+                                               __ATOMIC_RELAXED);
+        if (sample->worker_count > header->thread_count) {
+            sample->worker_count = header->thread_count;
+        }
+        sample->time = get_time_in_seconds();
+        for (int i = 0; i < sample->worker_count; ++i) {
+            sample->iter_counts[i] = __atomic_load_n(
+                &telemetry->slots[i].iter_count, __ATOMIC_RELAXED);
+        }
+    } while (__atomic_load_n(&header->run_id, __ATOMIC_ACQUIRE) != run_id);
+    sample->run_id = run_id;
+}
+
+void print_report(telemetry_t* telemetry, sample_t* previous, sample_t* current) {
+    telemetry_header_t* header = telemetry->header;
+    double interval = current->time - previous->time;
+    long long total = 0;
+    double total_rate = 0;
+    double min_rate = 0;
+    double max_rate = 0;
+    int worker_count = current->worker_count;
+    for (int i = 0; i < worker_count; ++i) {
+        long long delta = current->iter_counts[i] - previous->iter_counts[i];
+        double rate = delta / interval;
+        double update_time;
+        __atomic_load(&telemetry->slots[i].update_time, &update_time,
+                      __ATOMIC_ACQUIRE);
+        printf("  thread %3d: %12.4g it/s  %16lld it  updated %.2f s ago\n",
+            i, rate, current->iter_counts[i], current->time - update_time);
+        total += current->iter_counts[i];
+        total_rate += rate;
+        min_rate = i == 0 || rate < min_rate ? rate : min_rate;
+        max_rate = i == 0 || rate > max_rate ? rate : max_rate;
+    }
+
+    double mean_rate = worker_count > 0 ? total_rate / worker_count : 0;
+    double imbalance = mean_rate > 0 ? (max_rate - min_rate) / mean_rate : 0;
+    long long target = __atomic_load_n(&header->target_iter_count,
+                                       __ATOMIC_RELAXED);
+    printf("run %lld: %lld of %lld it (%.2f%%)  %.4g it/s  "
+        "imbalance %.1f%%  ETA ",
+        current->run_id, total, target,
+        target > 0 ? 100.0 * total / target : 0, total_rate, imbalance * 100);
+    if (total_rate > 0 && target > total) {
+        printf("%.1f s\n\n", (target - total) / total_rate);
+    } else {
+        printf("-\n\n");
+    }
+    fflush(stdout);
+}
+
+void sleep_for(double seconds) {
+    struct timespec duration;
+    duration.tv_sec = (time_t) seconds;
+    duration.tv_nsec = (long)((seconds - duration.tv_sec) * 1e9);
+    nanosleep(&duration, NULL);
+}
+
+int is_process_alive(int pid) {
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/*****************************************************************************
+ * Cleanup data and cleanup routine.
+ ****************************************************************************/
+
+typedef struct cleanup_data_s {
+    telemetry_t* telemetry;
+    long long* iter_counts;
+} cleanup_data_t;
+
+void cleanup_routine(void* arg) {
+    cleanup_data_t* cleanup_data = (cleanup_data_t*) arg;
+    free(cleanup_data->iter_counts);
+    if (cleanup_data->telemetry != NULL) {
+        telemetry_destroy(cleanup_data->telemetry);
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < MIN_ARGS_COUNT || argc > MAX_ARGS_COUNT) {
+        exit_with_custom_message("Usage: <program_name> <stats_name> "
+            "[interval_seconds]", EXIT_FAILURE);
+    }
+    double interval = DEFAULT_INTERVAL;
+    if (argc == MAX_ARGS_COUNT) {
+        char* end_pointer;
+        interval = strtod(argv[2], &end_pointer);
+        exit_if_true_with_message(*end_pointer != '\0' || interval <= 0,
+            "Interval must be a positive number of seconds");
+    }
+
+    cleanup_data_t cleanup_data = { NULL, NULL };
+    telemetry_t telemetry;
+    int code = telemetry_attach(&telemetry, argv[1]);
+    if (code != SUCCESS) {
+        log_error("Unable to open stats segment", code);
+        exit(EXIT_FAILURE);
+    }
+    cleanup_data.telemetry = &telemetry;
+
+    int thread_count = telemetry.header->thread_count;
+    cleanup_data.iter_counts = (long long*)malloc(
+        2 * thread_count * sizeof(long long));
+    if (cleanup_data.iter_counts == NULL) {
+        log_error("Unable to allocate samples", ENOMEM);
+        exit_with_cleanup(EXIT_FAILURE, cleanup_routine, &cleanup_data);
+    }
+    sample_t samples[2] = {
+        { 0, 0, 0, cleanup_data.iter_counts },
+        { 0, 0, 0, cleanup_data.iter_counts + thread_count }
+    };
+
+    /* Samples are taken until the computing process exits, rates are
+     * only reported for intervals within a single run */
+    int current = 0;
+    take_sample(&telemetry, samples + current);
+    while (is_process_alive(telemetry.header->pid)) {
+        sleep_for(interval);
+        current = 1 - current;
+        take_sample(&telemetry, samples + current);
+        if (samples[current].run_id == samples[1 - current].run_id) {
+            print_report(&telemetry, samples + 1 - current, samples + current);
+        }
+    }
+    exit_with_cleanup(EXIT_SUCCESS, cleanup_routine, &cleanup_data);
+}
@@ -0,0 +1,149 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdlib.h>
+#include <errno.h>
+#include "chunk_scheduler.h"
+
+/*
+ * Number of chunks taken from the shared cursor at once. Small batches
+ * keep little work stuck behind a descheduled worker.
+ */
+#define BATCH_CHUNK_COUNT 4
+
+static void to_chunk(chunk_scheduler_t* scheduler, long long index,
+        chunk_t* chunk) {
+    chunk->from = scheduler->first_iteration + index * scheduler->chunk_size;
+    chunk->to = chunk->from + scheduler->chunk_size;
+    if (chunk->to > scheduler->iteration_limit) {
+        chunk->to = scheduler->iteration_limit;
+    }
+}
+
+static int pop_own(chunk_deque_t* deque, long long* index) {
+    int code = FAILURE;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->low < deque->high) {
+        *index = deque->low++;
+        code = SUCCESS;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return code;
+}
+
+static int steal(chunk_deque_t* deque, long long* index) {
+    int code = FAILURE;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->low < deque->high) {
+        *index = --deque->high;
+        code = SUCCESS;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return code;
+}
+
+/*
+ * Function takes a batch from the shared cursor, keeps its first chunk
+ * in index and puts the rest into the worker's deque.
+ */
+static int refill(chunk_scheduler_t* scheduler, chunk_deque_t* deque,
+        long long* index) {
+    if (__atomic_load_n(&scheduler->stopped, __ATOMIC_ACQUIRE)) {
+        return FAILURE;
+    }
+    long long first = __atomic_fetch_add(&scheduler->next_chunk,
+        BATCH_CHUNK_COUNT, __ATOMIC_RELAXED);
+    if (first >= scheduler->chunk_count) {
+        return FAILURE;
+    }
+    long long last = first + BATCH_CHUNK_COUNT;
+    if (last > scheduler->chunk_count) {
+        last = scheduler->chunk_count;
+    }
+    pthread_mutex_lock(&deque->mutex);
+    deque->low = first + 1;
+    deque->high = last;
+    deque->claimed_end = last;
+    pthread_mutex_unlock(&deque->mutex);
+    *index = first;
+    return SUCCESS;
+}
+
+int chunk_scheduler_init(chunk_scheduler_t* scheduler, int max_worker_count,
+        long long iteration_limit, long long chunk_size) {
+    void* deques = NULL;
+    int code = posix_memalign(&deques, CACHE_LINE_SIZE,
+                              max_worker_count * sizeof(chunk_deque_t));
+    if (code != SUCCESS) {
+        return code;
+    }
+    scheduler->deques = (chunk_deque_t*) deques;
+    scheduler->worker_count = max_worker_count;
+    scheduler->max_worker_count = max_worker_count;
+    scheduler->iteration_limit = iteration_limit;
+    scheduler->chunk_size = chunk_size;
+    for (int i = 0; i < max_worker_count; ++i) {
+        pthread_mutex_init(&scheduler->deques[i].mutex, DEFAULT_ATTR);
+    }
+    chunk_scheduler_reset(scheduler, 0);
+    return SUCCESS;
+}
+
+void chunk_scheduler_resize(chunk_scheduler_t* scheduler, int worker_count) {
+    scheduler->worker_count = worker_count;
+}
+
+void chunk_scheduler_reset(chunk_scheduler_t* scheduler,
+        long long first_iteration) {
+    scheduler->first_iteration = first_iteration;
+    scheduler->chunk_count = (scheduler->iteration_limit - first_iteration +
+        scheduler->chunk_size - 1) / scheduler->chunk_size;
+    scheduler->next_chunk = 0;
+    scheduler->stopped = 0;
+    for (int i = 0; i < scheduler->max_worker_count; ++i) {
+        scheduler->deques[i].low = 0;
+        scheduler->deques[i].high = 0;
+        scheduler->deques[i].claimed_end = 0;
+    }
+}
+
+int chunk_scheduler_next(chunk_scheduler_t* scheduler, int worker_id,
+        chunk_t* chunk) {
+    chunk_deque_t* own = scheduler->deques + worker_id;
+    long long index;
+    if (pop_own(own, &index) == SUCCESS ||
+            refill(scheduler, own, &index) == SUCCESS) {
+        to_chunk(scheduler, index, chunk);
+        return SUCCESS;
+    }
+    for (int i = 1; i < scheduler->worker_count; ++i) {
+        int victim = (worker_id + i) % scheduler->worker_count;
+        if (steal(scheduler->deques + victim, &index) == SUCCESS) {
+            to_chunk(scheduler, index, chunk);
+            return SUCCESS;
+        }
+    }
+    return FAILURE;
+}
+
+void chunk_scheduler_stop(chunk_scheduler_t* scheduler) {
+    __atomic_store_n(&scheduler->stopped, 1, __ATOMIC_RELEASE);
+}
+
+long long chunk_scheduler_claimed_end(chunk_scheduler_t* scheduler,
+        int worker_id) {
+    chunk_deque_t* deque = scheduler->deques + worker_id;
+    pthread_mutex_lock(&deque->mutex);
+    long long claimed_end = scheduler->first_iteration +
+        deque->claimed_end * scheduler->chunk_size;
+    pthread_mutex_unlock(&deque->mutex);
+    return claimed_end < scheduler->iteration_limit ?
+        claimed_end : scheduler->iteration_limit;
+}
+
+void chunk_scheduler_destroy(chunk_scheduler_t* scheduler) {
+    for (int i = 0; i < scheduler->max_worker_count; ++i) {
+        pthread_mutex_destroy(&scheduler->deques[i].mutex);
+    }
+    free(scheduler->deques);
+}
@@ -0,0 +1,91 @@
+#ifndef chunk_scheduler_h
+#define chunk_scheduler_h
+
+#include <pthread.h>
+#include "util.h"
+
+/*
+ * Half-open range of iterations [from, to).
+ */
+typedef struct chunk_s {
+    long long from;
+    long long to;
+} chunk_t;
+
+/*
+ * Per-worker deque of consecutive chunk indices [low, high).
+ * The owner takes chunks from the low end, thieves from the high end.
+ */
+typedef struct chunk_deque_s {
+    pthread_mutex_t mutex;
+    long long low;
+    long long high;
+    long long claimed_end;
+} __attribute__((aligned(CACHE_LINE_SIZE))) chunk_deque_t;
+
+/*
+ * Iteration space [first_iteration, iteration_limit) split into chunks
+ * of chunk_size iterations. Workers refill their deques with batches of chunks from
+ * a shared cursor, so the chunks handed out always form a prefix of the
+ * space, and steal from other deques when the cursor is exhausted or
+ * stopped. Deques of max_worker_count workers are allocated, the first
+ * worker_count of them take part.
+ */
+typedef struct chunk_scheduler_s {
+    long long first_iteration;
+    long long iteration_limit;
+    long long chunk_size;
+    long long chunk_count;
+    long long next_chunk;
+    int stopped;
+    int worker_count;
+    int max_worker_count;
+    chunk_deque_t* deques;
+} chunk_scheduler_t;
+
+/*
+ * Scheduler starts with the whole space [0, iteration_limit) and
+ * all max_worker_count workers taking part.
+ * Returns SUCCESS or error code.
+ */
+int chunk_scheduler_init(chunk_scheduler_t* scheduler, int max_worker_count,
+        long long iteration_limit, long long chunk_size);
+
+/*
+ * Function sets the number of workers taking part, at most
+ * max_worker_count. Must be called when no worker is using the
+ * scheduler, before chunk_scheduler_reset().
+ */
+void chunk_scheduler_resize(chunk_scheduler_t* scheduler, int worker_count);
+
+/*
+ * Function makes iterations [first_iteration, iteration_limit) available
+ * again. Must be called when no worker is using the scheduler.
+ */
+void chunk_scheduler_reset(chunk_scheduler_t* scheduler,
+        long long first_iteration);
+
+/*
+ * Function stores next chunk for worker_id in chunk: from its own deque,
+ * else from a new batch, else stolen from another worker.
+ * Returns FAILURE when there are no chunks left.
+ */
+int chunk_scheduler_next(chunk_scheduler_t* scheduler, int worker_id,
+        chunk_t* chunk);
+
+/*
+ * Function stops handing out new batches. Chunks already in deques
+ * are still returned by chunk_scheduler_next().
+ */
+void chunk_scheduler_stop(chunk_scheduler_t* scheduler);
+
+/*
+ * Function returns end of the last iteration handed out to worker_id
+ * since the last reset.
+ */
+long long chunk_scheduler_claimed_end(chunk_scheduler_t* scheduler,
+        int worker_id);
+
+void chunk_scheduler_destroy(chunk_scheduler_t* scheduler);
+
+#endif /* chunk_scheduler_h */
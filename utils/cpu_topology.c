@@ -0,0 +1,293 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sched.h>
+#include "util.h"
+#include "cpu_topology.h"
+
+#define SYS_CPU_PATH "/sys/devices/system/cpu"
+#define PATH_SIZE 256
+#define LINE_SIZE 4096
+
+/*****************************************************************************
+ * Reading /sys.
+ ****************************************************************************/
+
+static int read_line(const char* path, char* line, int size) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return errno;
+    }
+    int code = fgets(line, size, file) != NULL ? SUCCESS : EIO;
+    fclose(file);
+    return code;
+}
+
+static int read_cpu_value(int cpu, const char* name, int* value) {
+    char path[PATH_SIZE];
+    char line[LINE_SIZE];
+    snprintf(path, sizeof(path), SYS_CPU_PATH "/cpu%d/topology/%s", cpu, name);
+    int code = read_line(path, line, sizeof(line));
+    if (code == SUCCESS) {
+        *value = atoi(line);
+    }
+    return code;
+}
+
+/*
+ * Node of a CPU is the nodeN entry of its directory. Kernels without
+ * NUMA have no such entry and everything is node 0.
+ */
+static int read_cpu_node(int cpu) {
+    char path[PATH_SIZE];
+    snprintf(path, sizeof(path), SYS_CPU_PATH "/cpu%d", cpu);
+    DIR* directory = opendir(path);
+    if (directory == NULL) {
+        return 0;
+    }
+    int node = 0;
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 &&
+                isdigit((unsigned char) entry->d_name[4])) {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(directory);
+    return node;
+}
+
+/*
+ * Function parses list like "0-3,8,10-11" into at most max_count CPUs
+ * in the listed order. Returns SUCCESS or EINVAL.
+ */
+static int parse_cpu_list(const char* text, int* cpus, int max_count,
+        int* count) {
+    *count = 0;
+    const char* position = text;
+    while (*position != '\0' && *position != '\n') {
+        char* end;
+        long first = strtol(position, &end, 10);
+        long last = first;
+        if (end == position || first < 0) {
+            return EINVAL;
+        }
+        if (*end == '-') {
+            position = end + 1;
+            last = strtol(position, &end, 10);
+            if (end == position || last < first) {
+                return EINVAL;
+            }
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            if (*count == max_count) {
+                return EINVAL;
+            }
+            cpus[(*count)++] = (int) cpu;
+        }
+        if (*end == ',') {
+            ++end;
+        } else if (*end != '\0' && *end != '\n') {
+            return EINVAL;
+        }
+        position = end;
+    }
+    return *count > 0 ? SUCCESS : EINVAL;
+}
+
+int cpu_topology_detect(cpu_topology_t* topology) {
+    char line[LINE_SIZE];
+    int online[CPU_SETSIZE];
+    int online_count;
+    int code = read_line(SYS_CPU_PATH "/online", line, sizeof(line));
+    if (code == SUCCESS) {
+        code = parse_cpu_list(line, online, CPU_SETSIZE, &online_count);
+    }
+    cpu_set_t allowed;
+    if (code == SUCCESS && sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        code = errno;
+    }
+    if (code != SUCCESS) {
+        return code;
+    }
+
+    topology->cpu_count = 0;
+    topology->cpus = (cpu_info_t*)malloc(online_count * sizeof(cpu_info_t));
+    if (topology->cpus == NULL) {
+        return ENOMEM;
+    }
+    for (int i = 0; i < online_count; ++i) {
+        if (!CPU_ISSET(online[i], &allowed)) {
+            continue;
+        }
+        cpu_info_t* info = topology->cpus + topology->cpu_count;
+        info->cpu = online[i];
+        info->node = read_cpu_node(online[i]);
+        /* Without topology entries every CPU is its own core */
+        if (read_cpu_value(online[i], "physical_package_id", &info->package)
+                != SUCCESS) {
+            info->package = 0;
+        }
+        if (read_cpu_value(online[i], "core_id", &info->core) != SUCCESS) {
+            info->core = online[i];
+        }
+        topology->cpu_count++;
+    }
+    if (topology->cpu_count == 0) {
+        free(topology->cpus);
+        return ENODEV;
+    }
+    return SUCCESS;
+}
+
+/*****************************************************************************
+ * Placement.
+ ****************************************************************************/
+
+/*
+ * Sort key of a CPU: for compact placement it is its position
+ * (node, package, core, cpu); for scatter placement it is the rank
+ * of the SMT sibling within its core, the rank of the core within
+ * its node and then the node.
+ */
+typedef struct placement_key_s {
+    int keys[4];
+    int cpu;
+} placement_key_t;
+
+static int compare_keys(const void* left, const void* right) {
+    const placement_key_t* a = (const placement_key_t*) left;
+    const placement_key_t* b = (const placement_key_t*) right;
+    for (int i = 0; i < 4; ++i) {
+        if (a->keys[i] != b->keys[i]) {
+            return a->keys[i] < b->keys[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static int is_same_core(cpu_info_t* a, cpu_info_t* b) {
+    return a->node == b->node && a->package == b->package && a->core == b->core;
+}
+
+/*
+ * Function returns the lowest CPU number among siblings of cpus[index].
+ */
+static int first_sibling(cpu_topology_t* topology, int index) {
+    int first = topology->cpus[index].cpu;
+    for (int i = 0; i < topology->cpu_count; ++i) {
+        if (is_same_core(topology->cpus + i, topology->cpus + index) &&
+                topology->cpus[i].cpu < first) {
+            first = topology->cpus[i].cpu;
+        }
+    }
+    return first;
+}
+
+/*
+ * SMT rank of a CPU is the number of its siblings with lower numbers,
+ * core rank is the number of cores of the same node whose first
+ * sibling has a lower number.
+ */
+static void rank_cpu(cpu_topology_t* topology, int index, int* smt_rank,
+        int* core_rank) {
+    cpu_info_t* info = topology->cpus + index;
+    int own_first = first_sibling(topology, index);
+    *smt_rank = 0;
+    *core_rank = 0;
+    for (int i = 0; i < topology->cpu_count; ++i) {
+        cpu_info_t* other = topology->cpus + i;
+        if (is_same_core(other, info)) {
+            *smt_rank += other->cpu < info->cpu;
+        } else if (other->node == info->node &&
+                other->cpu == first_sibling(topology, i) &&
+                other->cpu < own_first) {
+            ++*core_rank;
+        }
+    }
+}
+
+static int place_by_topology(cpu_topology_t* topology, int scatter,
+        int thread_count, int* cpus) {
+    placement_key_t* order = (placement_key_t*)malloc(
+        topology->cpu_count * sizeof(placement_key_t));
+    if (order == NULL) {
+        return ENOMEM;
+    }
+    for (int i = 0; i < topology->cpu_count; ++i) {
+        cpu_info_t* info = topology->cpus + i;
+        order[i].cpu = info->cpu;
+        if (scatter) {
+            rank_cpu(topology, i, order[i].keys, order[i].keys + 1);
+            order[i].keys[2] = info->node;
+            order[i].keys[3] = info->package;
+        } else {
+            order[i].keys[0] = info->node;
+            order[i].keys[1] = info->package;
+            order[i].keys[2] = info->core;
+            order[i].keys[3] = info->cpu;
+        }
+    }
+    qsort(order, topology->cpu_count, sizeof(placement_key_t), compare_keys);
+    for (int i = 0; i < thread_count; ++i) {
+        cpus[i] = order[i % topology->cpu_count].cpu;
+    }
+    free(order);
+    return SUCCESS;
+}
+
+static int find_cpu(cpu_topology_t* topology, int cpu) {
+    for (int i = 0; i < topology->cpu_count; ++i) {
+        if (topology->cpus[i].cpu == cpu) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int cpu_topology_place(cpu_topology_t* topology, const char* placement,
+        int thread_count, int* cpus) {
+    if (strcmp(placement, "compact") == 0) {
+        return place_by_topology(topology, 0, thread_count, cpus);
+    }
+    if (strcmp(placement, "scatter") == 0) {
+        return place_by_topology(topology, 1, thread_count, cpus);
+    }
+    int listed[CPU_SETSIZE];
+    int listed_count;
+    int code = parse_cpu_list(placement, listed, CPU_SETSIZE, &listed_count);
+    if (code != SUCCESS) {
+        return code;
+    }
+    for (int i = 0; i < listed_count; ++i) {
+        if (find_cpu(topology, listed[i]) < 0) {
+            return EINVAL;
+        }
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        cpus[i] = listed[i % listed_count];
+    }
+    return SUCCESS;
+}
+
+void cpu_topology_destroy(cpu_topology_t* topology) {
+    free(topology->cpus);
+}
+
+int cpu_place_threads(const char* placement, int thread_count, int* cpus) {
+    cpu_topology_t topology;
+    int code = cpu_topology_detect(&topology);
+    if (code != SUCCESS) {
+        return code;
+    }
+    code = cpu_topology_place(&topology, placement, thread_count, cpus);
+    cpu_topology_destroy(&topology);
+    return code;
+}
@@ -0,0 +1,52 @@
+#ifndef cpu_topology_h
+#define cpu_topology_h
+
+/*
+ * Location of a logical CPU: NUMA node, socket and physical core.
+ * Logical CPUs with the same package and core are SMT siblings.
+ */
+typedef struct cpu_info_s {
+    int cpu;
+    int node;
+    int package;
+    int core;
+} cpu_info_t;
+
+/*
+ * CPUs that are online and allowed for the process.
+ */
+typedef struct cpu_topology_s {
+    int cpu_count;
+    cpu_info_t* cpus;
+} cpu_topology_t;
+
+/*
+ * Function reads topology of CPUs the process may run on
+ * from /sys/devices/system. Returns SUCCESS or error code.
+ */
+int cpu_topology_detect(cpu_topology_t* topology);
+
+/*
+ * Function chooses a CPU for each of thread_count threads and stores
+ * it in cpus. Placement is one of:
+ *   "compact" - fill SMT siblings, then cores, then packages and nodes;
+ *   "scatter" - spread threads over nodes and packages first, then over
+ *               cores, SMT siblings are used last;
+ *   CPU list in /sys format, e.g. "0-3,8,10-11" - threads take the listed
+ *               CPUs in order.
+ * Threads wrap around when there are fewer CPUs than threads.
+ * Returns SUCCESS or EINVAL if placement can not be parsed or lists
+ * a CPU that is not available.
+ */
+int cpu_topology_place(cpu_topology_t* topology, const char* placement,
+        int thread_count, int* cpus);
+
+void cpu_topology_destroy(cpu_topology_t* topology);
+
+/*
+ * Function detects topology and places thread_count threads
+ * as cpu_topology_place() does. Returns SUCCESS or error code.
+ */
+int cpu_place_threads(const char* placement, int thread_count, int* cpus);
+
+#endif /* cpu_topology_h */
@@ -0,0 +1,24 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "futex.h"
+
+void futex_wait(int* word, int value) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+void futex_timed_wait(int* word, int value, double timeout) {
+    struct timespec relative;
+    relative.tv_sec = (time_t) timeout;
+    relative.tv_nsec = (long)((timeout - relative.tv_sec) * 1e9);
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, &relative, NULL, 0);
+}
+
+void futex_wake(int* word, int count) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
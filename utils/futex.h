@@ -0,0 +1,27 @@
+#ifndef futex_h
+#define futex_h
+
+/*
+ * Thin wrappers of the Linux futex system call on private
+ * (not shared between processes) 32-bit words.
+ */
+
+/*
+ * Function blocks while *word is equal to value, until futex_wake()
+ * on word, a signal or a spurious wakeup. The kernel compares the word
+ * atomically with going to sleep, so a wake that follows a change
+ * of the word is never lost. Callers recheck their condition.
+ */
+void futex_wait(int* word, int value);
+
+/*
+ * Function is futex_wait() that also returns after timeout seconds.
+ */
+void futex_timed_wait(int* word, int value, double timeout);
+
+/*
+ * Function wakes up to count threads blocked on word.
+ */
+void futex_wake(int* word, int count);
+
+#endif /* futex_h */
@@ -0,0 +1,71 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <errno.h>
+#include <limits.h>
+#include "util.h"
+#include "futex.h"
+#include "latch.h"
+
+int latch_init(latch_t* latch, int count) {
+    latch->count = count;
+    latch->waiting = 0;
+    return SUCCESS;
+}
+
+void latch_reset(latch_t* latch, int count) {
+    __atomic_store_n(&latch->waiting, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&latch->count, count, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * The waiter announces that it waits and only then reads count,
+ * count_down() changes count and only then looks for waiters.
+ * Both are sequentially consistent, so either the waiter sees zero
+ * or the last count_down() sees it waiting and wakes it.
+ */
+void latch_count_down(latch_t* latch) {
+    if (__atomic_sub_fetch(&latch->count, 1, __ATOMIC_SEQ_CST) == 0
+            && __atomic_load_n(&latch->waiting, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(&latch->count, INT_MAX);
+    }
+}
+
+/*
+ * Function returns count, announcing a waiter while it is positive.
+ */
+static int prepare_wait(latch_t* latch) {
+    int count = __atomic_load_n(&latch->count, __ATOMIC_SEQ_CST);
+    if (count > 0) {
+        __atomic_store_n(&latch->waiting, 1, __ATOMIC_SEQ_CST);
+        count = __atomic_load_n(&latch->count, __ATOMIC_SEQ_CST);
+    }
+    return count;
+}
+
+/*
+ * The futex returns at once when count has changed since it was read,
+ * so a waiter sleeps again after every count_down() but the last.
+ */
+void latch_wait(latch_t* latch) {
+    int count;
+    while ((count = prepare_wait(latch)) > 0) {
+        futex_wait(&latch->count, count);
+    }
+}
+
+int latch_timed_wait(latch_t* latch, double timeout) {
+    double deadline = get_time_in_seconds() + timeout;
+    int count;
+    while ((count = prepare_wait(latch)) > 0) {
+        double left = deadline - get_time_in_seconds();
+        if (left <= 0) {
+            return ETIMEDOUT;
+        }
+        futex_timed_wait(&latch->count, count, left);
+    }
+    return SUCCESS;
+}
+
+void latch_destroy(latch_t* latch) {
+}
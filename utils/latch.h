@@ -0,0 +1,44 @@
+#ifndef latch_h
+#define latch_h
+
+/*
+ * Countdown latch: latch_wait() blocks until latch_count_down()
+ * was called count times. count is the futex word waiters sleep on,
+ * waiting is set once somebody sleeps, so counting down to zero makes
+ * a system call only when there is someone to wake.
+ */
+typedef struct latch_s {
+    int count;
+    int waiting;
+} latch_t;
+
+/*
+ * Function initializes latch with count. Returns SUCCESS.
+ */
+int latch_init(latch_t* latch, int count);
+
+/*
+ * Function sets new count of a latch that nobody is waiting on.
+ */
+void latch_reset(latch_t* latch, int count);
+
+/*
+ * Function decrements count and wakes up waiting threads
+ * when it reaches zero.
+ */
+void latch_count_down(latch_t* latch);
+
+/*
+ * Function blocks until count reaches zero.
+ */
+void latch_wait(latch_t* latch);
+
+/*
+ * Function blocks until count reaches zero or timeout in seconds passes.
+ * Returns SUCCESS or ETIMEDOUT.
+ */
+int latch_timed_wait(latch_t* latch, double timeout);
+
+void latch_destroy(latch_t* latch);
+
+#endif /* latch_h */
@@ -0,0 +1,283 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "process_farm.h"
+
+#define NO_TASK (-1)
+
+/*
+ * Coordinator side of a worker: its socket end and the task
+ * it is running, if any.
+ */
+typedef struct farm_worker_s {
+    pid_t pid;
+    int fd;
+    int task;
+} farm_worker_t;
+
+/*
+ * Tasks are handed out from next_task on; tasks of dead workers are
+ * pushed to retry_tasks and handed out first.
+ */
+typedef struct farm_s {
+    task_routine_t routine;
+    char* tasks;
+    size_t task_size;
+    int task_count;
+    int next_task;
+    int* retry_tasks;
+    int retry_count;
+    int process_count;
+    farm_worker_t* workers;
+} farm_t;
+
+/*****************************************************************************
+ * Socket io. Messages are small, but a stream socket may still
+ * transfer them in parts. MSG_NOSIGNAL keeps the coordinator alive
+ * when it writes to a worker that has just died.
+ ****************************************************************************/
+
+static int send_all(int fd, const void* buffer, size_t size) {
+    const char* position = (const char*) buffer;
+    while (size > 0) {
+        ssize_t sent = send(fd, position, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return sent < 0 ? errno : EPIPE;
+        }
+        position += sent;
+        size -= sent;
+    }
+    return SUCCESS;
+}
+
+/*
+ * Returns SUCCESS, EPIPE if the other side has closed the socket
+ * or error code.
+ */
+static int receive_all(int fd, void* buffer, size_t size) {
+    char* position = (char*) buffer;
+    while (size > 0) {
+        ssize_t received = recv(fd, position, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return received < 0 ? errno : EPIPE;
+        }
+        position += received;
+        size -= received;
+    }
+    return SUCCESS;
+}
+
+/*****************************************************************************
+ * Worker process.
+ ****************************************************************************/
+
+static void run_worker(farm_t* farm, int id, int fd) {
+    char task[farm->task_size];
+    pool_worker_t worker;
+    memset(&worker, 0, sizeof(worker));
+    worker.id = id;
+    worker.cpu = -1;
+    while (receive_all(fd, task, farm->task_size) == SUCCESS) {
+        worker.result = 0;
+        farm->routine(task, &worker);
+        if (send_all(fd, &worker.result, sizeof(worker.result)) != SUCCESS) {
+            break;
+        }
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+/*
+ * Function forks worker id. The child closes sockets of all other
+ * workers, so that only the worker itself holds the other end
+ * of its socket and its death is seen by the coordinator as EOF.
+ */
+static int spawn_worker(farm_t* farm, int id) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        return errno;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        int code = errno;
+        close(sockets[0]);
+        close(sockets[1]);
+        return code;
+    }
+    if (pid == 0) {
+        close(sockets[0]);
+        for (int i = 0; i < farm->process_count; ++i) {
+            if (farm->workers[i].fd >= 0) {
+                close(farm->workers[i].fd);
+            }
+        }
+        run_worker(farm, id, sockets[1]);
+    }
+    close(sockets[1]);
+    farm->workers[id].pid = pid;
+    farm->workers[id].fd = sockets[0];
+    farm->workers[id].task = NO_TASK;
+    return SUCCESS;
+}
+
+static void stop_worker(farm_worker_t* worker) {
+    if (worker->fd >= 0) {
+        close(worker->fd);
+        worker->fd = -1;
+    }
+    if (worker->pid > 0) {
+        waitpid(worker->pid, NULL, 0);
+        worker->pid = 0;
+    }
+}
+
+/*****************************************************************************
+ * Coordinator.
+ ****************************************************************************/
+
+static int take_task(farm_t* farm) {
+    if (farm->retry_count > 0) {
+        return farm->retry_tasks[--farm->retry_count];
+    }
+    if (farm->next_task < farm->task_count) {
+        return farm->next_task++;
+    }
+    return NO_TASK;
+}
+
+/*
+ * Function gives the next task to an idle worker. A worker that can
+ * not be written to is left for poll() to report.
+ */
+static void assign_task(farm_t* farm, farm_worker_t* worker) {
+    int task = take_task(farm);
+    if (task == NO_TASK) {
+        return;
+    }
+    worker->task = task;
+    send_all(worker->fd, farm->tasks + task * farm->task_size, farm->task_size);
+}
+
+/*
+ * Function replaces dead worker id with a new one and gives its task
+ * to the first idle worker.
+ */
+static int replace_worker(farm_t* farm, int id, int* reassigned_count) {
+    farm_worker_t* worker = farm->workers + id;
+    if (worker->task != NO_TASK) {
+        farm->retry_tasks[farm->retry_count++] = worker->task;
+        ++*reassigned_count;
+    }
+    stop_worker(worker);
+    if (*reassigned_count > farm->task_count) {
+        return ECHILD;
+    }
+    int code = spawn_worker(farm, id);
+    if (code != SUCCESS) {
+        return code;
+    }
+    for (int i = 0; i < farm->process_count; ++i) {
+        if (farm->workers[i].task == NO_TASK) {
+            assign_task(farm, farm->workers + i);
+        }
+    }
+    return SUCCESS;
+}
+
+static int collect_results(farm_t* farm, double* results,
+        int* reassigned_count) {
+    struct pollfd fds[farm->process_count];
+    int done_count = 0;
+    while (done_count < farm->task_count) {
+        for (int i = 0; i < farm->process_count; ++i) {
+            fds[i].fd = farm->workers[i].fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        if (poll(fds, farm->process_count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        for (int i = 0; i < farm->process_count; ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            farm_worker_t* worker = farm->workers + i;
+            double result;
+            if (worker->task == NO_TASK || receive_all(worker->fd, &result,
+                    sizeof(result)) != SUCCESS) {
+                int code = replace_worker(farm, i, reassigned_count);
+                if (code != SUCCESS) {
+                    return code;
+                }
+                continue;
+            }
+            results[worker->task] = result;
+            ++done_count;
+            worker->task = NO_TASK;
+            assign_task(farm, worker);
+        }
+    }
+    return SUCCESS;
+}
+
+int process_farm_run(int process_count, task_routine_t routine, void* tasks,
+        size_t task_size, int task_count, double* results,
+        int* reassigned_count) {
+    farm_t farm;
+    farm.routine = routine;
+    farm.tasks = (char*) tasks;
+    farm.task_size = task_size;
+    farm.task_count = task_count;
+    farm.next_task = 0;
+    farm.retry_count = 0;
+    farm.process_count = process_count;
+    farm.retry_tasks = (int*)malloc(task_count * sizeof(int));
+    farm.workers = (farm_worker_t*)malloc(process_count * sizeof(farm_worker_t));
+    if (farm.retry_tasks == NULL || farm.workers == NULL) {
+        free(farm.retry_tasks);
+        free(farm.workers);
+        return ENOMEM;
+    }
+    for (int i = 0; i < process_count; ++i) {
+        farm.workers[i].pid = 0;
+        farm.workers[i].fd = -1;
+        farm.workers[i].task = NO_TASK;
+    }
+
+    *reassigned_count = 0;
+    int code = SUCCESS;
+    for (int i = 0; i < process_count && code == SUCCESS; ++i) {
+        code = spawn_worker(&farm, i);
+    }
+    for (int i = 0; i < process_count && code == SUCCESS; ++i) {
+        assign_task(&farm, farm.workers + i);
+    }
+    if (code == SUCCESS) {
+        code = collect_results(&farm, results, reassigned_count);
+    }
+
+    /* Workers leave when their sockets are closed */
+    for (int i = 0; i < process_count; ++i) {
+        stop_worker(farm.workers + i);
+    }
+    free(farm.retry_tasks);
+    free(farm.workers);
+    return code;
+}
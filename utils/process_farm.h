@@ -0,0 +1,30 @@
+#ifndef process_farm_h
+#define process_farm_h
+
+#include <stddef.h>
+#include "thread_pool.h"
+
+/*
+ * Function runs task_count tasks in process_count forked worker
+ * processes and stores result of task i in results[i].
+ *
+ * Tasks are task_size bytes each, packed in tasks. Every worker is
+ * connected to the coordinator by a Unix domain socket pair: the
+ * coordinator sends a task, the worker runs routine on it with its own
+ * pool_worker_t (id is the worker index, result starts at zero) and
+ * sends worker->result back. A worker gets its next task as soon as
+ * it replies.
+ *
+ * If a worker dies, its task is given to another worker and a new
+ * worker is forked in its place. The number of tasks taken from dead
+ * workers is stored in reassigned_count. The run fails with ECHILD if
+ * workers keep dying: more than task_count times in total.
+ *
+ * Must be called when the process has no other threads.
+ * Returns SUCCESS or error code.
+ */
+int process_farm_run(int process_count, task_routine_t routine, void* tasks,
+        size_t task_size, int task_count, double* results,
+        int* reassigned_count);
+
+#endif /* process_farm_h */
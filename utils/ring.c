@@ -0,0 +1,230 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include "futex.h"
+#include "ring.h"
+
+/*
+ * Rounds a thread retries before it parks. On a single CPU the other
+ * side can not run meanwhile, so it parks at once.
+ */
+#define SPIN_COUNT 100
+
+int ring_init(ring_t* ring, unsigned int capacity, int element_size, int flags) {
+    ring->elements = (char*)malloc((size_t) capacity * element_size);
+    if (ring->elements == NULL) {
+        return ENOMEM;
+    }
+    ring->producer.head = 0;
+    ring->producer.tail = 0;
+    ring->consumer.head = 0;
+    ring->consumer.tail = 0;
+    ring->not_full = 0;
+    ring->waiting_producers = 0;
+    ring->not_empty = 0;
+    ring->waiting_consumers = 0;
+    ring->closed = 0;
+    ring->flags = flags;
+    ring->element_size = element_size;
+    ring->spin_count = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_COUNT : 0;
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    return SUCCESS;
+}
+
+/*
+ * Function copies count elements between ring positions from index
+ * on and buffer, wrapping around the end of the ring.
+ */
+static void copy_elements(ring_t* ring, unsigned int index, char* buffer,
+        int count, int into_ring) {
+    unsigned int first = index & ring->mask;
+    unsigned int first_count = ring->capacity - first;
+    if (first_count > (unsigned int) count) {
+        first_count = count;
+    }
+    size_t first_size = (size_t) first_count * ring->element_size;
+    size_t rest_size = (size_t)(count - first_count) * ring->element_size;
+    char* slot = ring->elements + (size_t) first * ring->element_size;
+    if (into_ring) {
+        memcpy(slot, buffer, first_size);
+        memcpy(ring->elements, buffer + first_size, rest_size);
+    } else {
+        memcpy(buffer, slot, first_size);
+        memcpy(buffer + first_size, ring->elements, rest_size);
+    }
+}
+
+/*
+ * Function claims up to count positions on side below *limit + offset,
+ * where limit is the tail of the other side, and returns their number
+ * and the first one in head. The limit is read again on every attempt:
+ * other threads of the side may have claimed past an old one.
+ */
+static unsigned int claim(ring_side_t* side, int single, unsigned int* limit,
+        unsigned int offset, unsigned int count, unsigned int* head) {
+    *head = __atomic_load_n(&side->head, __ATOMIC_RELAXED);
+    unsigned int claimed;
+    do {
+        unsigned int available = __atomic_load_n(limit, __ATOMIC_ACQUIRE) + offset
+            - *head;
+        claimed = available < count ? available : count;
+        if (claimed == 0) {
+            return 0;
+        }
+        if (single) {
+            __atomic_store_n(&side->head, *head + claimed, __ATOMIC_RELAXED);
+            return claimed;
+        }
+    } while (!__atomic_compare_exchange_n(&side->head, head, *head + claimed,
+                 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    return claimed;
+}
+
+/*
+ * Function publishes positions [head, head + count) of side after
+ * threads that claimed earlier positions have published theirs.
+ */
+static void publish(ring_side_t* side, unsigned int head, unsigned int count) {
+    while (__atomic_load_n(&side->tail, __ATOMIC_ACQUIRE) != head) {
+        sched_yield();
+    }
+    __atomic_store_n(&side->tail, head + count, __ATOMIC_SEQ_CST);
+}
+
+static unsigned int try_push(ring_t* ring, const char* elements, unsigned int count) {
+    unsigned int head;
+    unsigned int claimed = claim(&ring->producer, ring->flags & RING_SINGLE_PRODUCER,
+        &ring->consumer.tail, ring->capacity, count, &head);
+    if (claimed > 0) {
+        copy_elements(ring, head, (char*) elements, claimed, 1);
+        publish(&ring->producer, head, claimed);
+    }
+    return claimed;
+}
+
+static unsigned int try_pop(ring_t* ring, char* elements, unsigned int count) {
+    unsigned int head;
+    unsigned int claimed = claim(&ring->consumer, ring->flags & RING_SINGLE_CONSUMER,
+        &ring->producer.tail, 0, count, &head);
+    if (claimed > 0) {
+        copy_elements(ring, head, elements, claimed, 0);
+        publish(&ring->consumer, head, claimed);
+    }
+    return claimed;
+}
+
+/*
+ * Function wakes threads parked on word if there are any. The side
+ * that changed the ring published it and only then looks for waiters,
+ * a waiter announces itself and only then looks at the ring once more.
+ * Both are sequentially consistent, so a wakeup is never lost.
+ */
+static void wake_waiters(int* word, int* waiting) {
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST) > 0) {
+        __atomic_add_fetch(word, 1, __ATOMIC_SEQ_CST);
+        futex_wake(word, INT_MAX);
+    }
+}
+
+static int is_closed(ring_t* ring) {
+    return __atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST);
+}
+
+static int is_full(ring_t* ring) {
+    return __atomic_load_n(&ring->producer.head, __ATOMIC_SEQ_CST)
+        - __atomic_load_n(&ring->consumer.tail, __ATOMIC_SEQ_CST) >= ring->capacity;
+}
+
+static int is_empty(ring_t* ring) {
+    return __atomic_load_n(&ring->producer.tail, __ATOMIC_SEQ_CST)
+        == __atomic_load_n(&ring->consumer.head, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Function blocks until ring stops being blocked() or gets closed.
+ */
+static void wait_for(ring_t* ring, int (*blocked)(ring_t*), int* word,
+        int* waiting) {
+    for (int i = 0; i < ring->spin_count; ++i) {
+        if (!blocked(ring) || is_closed(ring)) {
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    int value = __atomic_load_n(word, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(waiting, 1, __ATOMIC_SEQ_CST);
+    if (blocked(ring) && !is_closed(ring)) {
+        futex_wait(word, value);
+    }
+    __atomic_sub_fetch(waiting, 1, __ATOMIC_SEQ_CST);
+}
+
+int ring_push(ring_t* ring, const void* elements, int count) {
+    int pushed = 0;
+    while (pushed < count && !is_closed(ring)) {
+        unsigned int claimed = try_push(ring,
+            (const char*) elements + (size_t) pushed * ring->element_size,
+            count - pushed);
+        if (claimed > 0) {
+            pushed += claimed;
+            wake_waiters(&ring->not_empty, &ring->waiting_consumers);
+        } else {
+            wait_for(ring, is_full, &ring->not_full, &ring->waiting_producers);
+        }
+    }
+    return pushed;
+}
+
+int ring_pop(ring_t* ring, void* elements, int max_count) {
+    while (1) {
+        unsigned int claimed = try_pop(ring, (char*) elements, max_count);
+        if (claimed > 0) {
+            wake_waiters(&ring->not_full, &ring->waiting_producers);
+            return claimed;
+        }
+        if (is_closed(ring) && is_empty(ring)) {
+            return 0;
+        }
+        wait_for(ring, is_empty, &ring->not_empty, &ring->waiting_consumers);
+    }
+}
+
+int ring_pop_all(ring_t* ring, void* elements, int count) {
+    int popped = 0;
+    while (popped < count) {
+        int claimed = ring_pop(ring,
+            (char*) elements + (size_t) popped * ring->element_size,
+            count - popped);
+        if (claimed == 0) {
+            break;
+        }
+        popped += claimed;
+    }
+    return popped;
+}
+
+unsigned int ring_size(ring_t* ring) {
+    return __atomic_load_n(&ring->producer.tail, __ATOMIC_RELAXED)
+        - __atomic_load_n(&ring->consumer.tail, __ATOMIC_RELAXED);
+}
+
+void ring_close(ring_t* ring) {
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->not_full, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->not_empty, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&ring->not_full, INT_MAX);
+    futex_wake(&ring->not_empty, INT_MAX);
+}
+
+void ring_destroy(ring_t* ring) {
+    free(ring->elements);
+}
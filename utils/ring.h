@@ -0,0 +1,90 @@
+#ifndef ring_h
+#define ring_h
+
+#include "util.h"
+
+/* Flags of ring_init(): only one thread pushes, only one thread pops */
+#define RING_MULTI 0
+#define RING_SINGLE_PRODUCER 1
+#define RING_SINGLE_CONSUMER 2
+
+/*
+ * One side of a ring. Elements [tail, head) of the side are being
+ * copied in or out by threads that have claimed them; multiple threads
+ * of a side claim elements by moving head and publish them by moving
+ * tail in the order they claimed them. A single thread moves both.
+ */
+typedef struct ring_side_s {
+    unsigned int head;
+    unsigned int tail;
+} __attribute__((aligned(CACHE_LINE_SIZE))) ring_side_t;
+
+/*
+ * Bounded queue of capacity elements of element_size bytes. Elements
+ * [consumer.tail, producer.tail) are in the ring. Threads that find the
+ * ring full or empty park on not_full or not_empty, which count changes
+ * of the other side; waiting_producers and waiting_consumers count the
+ * parked threads, so the other side makes a system call only when
+ * somebody sleeps. A closed ring accepts no more elements and returns
+ * the ones left.
+ */
+typedef struct ring_s {
+    ring_side_t producer;
+    ring_side_t consumer;
+    int not_full __attribute__((aligned(CACHE_LINE_SIZE)));
+    int waiting_producers;
+    int not_empty __attribute__((aligned(CACHE_LINE_SIZE)));
+    int waiting_consumers;
+    int closed __attribute__((aligned(CACHE_LINE_SIZE)));
+    int flags;
+    int element_size;
+    int spin_count;
+    unsigned int capacity;
+    unsigned int mask;
+    char* elements;
+} ring_t;
+
+/*
+ * Function initializes ring of capacity elements, a power of two,
+ * each element_size bytes long. flags are RING_MULTI or a combination
+ * of RING_SINGLE_PRODUCER and RING_SINGLE_CONSUMER.
+ * Returns SUCCESS or error code.
+ */
+int ring_init(ring_t* ring, unsigned int capacity, int element_size, int flags);
+
+/*
+ * Function copies count elements into ring, blocking while it is full.
+ * Elements pushed by one call may be interleaved with elements of other
+ * producers when count exceeds the free space. Returns the number
+ * of elements pushed, less than count only if ring was closed.
+ */
+int ring_push(ring_t* ring, const void* elements, int count);
+
+/*
+ * Function copies from 1 to max_count elements out of ring, blocking
+ * while it is empty. Returns the number of elements popped, 0 only
+ * if ring was closed and is empty.
+ */
+int ring_pop(ring_t* ring, void* elements, int max_count);
+
+/*
+ * Function pops exactly count elements, blocking until they are all
+ * there. Returns count, or less only if ring was closed.
+ */
+int ring_pop_all(ring_t* ring, void* elements, int count);
+
+/*
+ * Function returns number of elements in ring. It is exact only when
+ * nobody pushes or pops.
+ */
+unsigned int ring_size(ring_t* ring);
+
+/*
+ * Function makes pushes fail and wakes up all waiting threads.
+ * Async-signal-safe.
+ */
+void ring_close(ring_t* ring);
+
+void ring_destroy(ring_t* ring);
+
+#endif /* ring_h */
@@ -0,0 +1,112 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "telemetry.h"
+
+#define TELEMETRY_MAGIC "PISTATS1"
+#define TELEMETRY_MODE 0644
+
+static size_t segment_size(int thread_count) {
+    return sizeof(telemetry_header_t) + thread_count * sizeof(telemetry_slot_t);
+}
+
+static int map_segment(telemetry_t* telemetry, int fd, int protection) {
+    void* address = mmap(NULL, telemetry->size, protection, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        return errno;
+    }
+    telemetry->header = (telemetry_header_t*) address;
+    telemetry->slots = (telemetry_slot_t*)((char*) address +
+                                           sizeof(telemetry_header_t));
+    return SUCCESS;
+}
+
+int telemetry_create(telemetry_t* telemetry, const char* name, int thread_count) {
+    telemetry->name = name;
+    telemetry->owner = 1;
+    telemetry->size = segment_size(thread_count);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, TELEMETRY_MODE);
+    if (fd < 0) {
+        return errno;
+    }
+    int code = ftruncate(fd, telemetry->size) == 0 ? SUCCESS : errno;
+    if (code == SUCCESS) {
+        code = map_segment(telemetry, fd, PROT_READ | PROT_WRITE);
+    }
+    close(fd);
+    if (code != SUCCESS) {
+        shm_unlink(name);
+        return code;
+    }
+
+    telemetry_header_t* header = telemetry->header;
+    header->pid = getpid();
+    header->thread_count = thread_count;
+    header->worker_count = 0;
+    header->run_id = 0;
+    header->target_iter_count = 0;
+    header->start_time = get_time_in_seconds();
+    /* Magic is written last: readers ignore the segment until then */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, TELEMETRY_MAGIC, sizeof(header->magic));
+    return SUCCESS;
+}
+
+int telemetry_attach(telemetry_t* telemetry, const char* name) {
+    telemetry->name = name;
+    telemetry->owner = 0;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return errno;
+    }
+    telemetry_header_t header;
+    ssize_t size = pread(fd, &header, sizeof(header), 0);
+    int code = size < 0 ? errno : SUCCESS;
+    if (code == SUCCESS && (size != sizeof(header) ||
+            memcmp(header.magic, TELEMETRY_MAGIC, sizeof(header.magic)) != 0)) {
+        code = EINVAL;
+    }
+    if (code == SUCCESS) {
+        telemetry->size = segment_size(header.thread_count);
+        code = map_segment(telemetry, fd, PROT_READ);
+    }
+    close(fd);
+    return code;
+}
+
+void telemetry_start_run(telemetry_t* telemetry, int worker_count,
+        long long target_iter_count) {
+    telemetry_header_t* header = telemetry->header;
+    double now = get_time_in_seconds();
+    for (int i = 0; i < header->thread_count; ++i) {
+        __atomic_store_n(&telemetry->slots[i].iter_count, 0, __ATOMIC_RELAXED);
+        __atomic_store(&telemetry->slots[i].update_time, &now, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&header->worker_count, worker_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->target_iter_count, target_iter_count,
+                     __ATOMIC_RELAXED);
+    __atomic_store(&header->start_time, &now, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&header->run_id, 1, __ATOMIC_RELEASE);
+}
+
+void telemetry_add(telemetry_t* telemetry, int thread_id, long long iter_count) {
+    telemetry_slot_t* slot = telemetry->slots + thread_id;
+    double now = get_time_in_seconds();
+    __atomic_store_n(&slot->iter_count, slot->iter_count + iter_count,
+                     __ATOMIC_RELAXED);
+    __atomic_store(&slot->update_time, &now, __ATOMIC_RELEASE);
+}
+
+void telemetry_destroy(telemetry_t* telemetry) {
+    munmap(telemetry->header, telemetry->size);
+    if (telemetry->owner) {
+        shm_unlink(telemetry->name);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <stddef.h>
+#include "util.h"
+
+/*
+ * Progress of one worker in the current run. Only the worker writes its
+ * slot, readers in other processes load the fields atomically, so no
+ * locks are involved. Slots are padded to a cache line so that workers
+ * do not invalidate each other's lines.
+ */
+typedef struct telemetry_slot_s {
+    long long iter_count;
+    double update_time;
+} __attribute__((aligned(CACHE_LINE_SIZE))) telemetry_slot_t;
+
+/*
+ * Shared memory segment: header followed by thread_count slots, of which
+ * the first worker_count are published by the workers of the current run.
+ * run_id changes on every run so that readers can tell a new run
+ * from a slow one. Times are CLOCK_MONOTONIC seconds, which are
+ * the same for all processes.
+ */
+typedef struct telemetry_header_s {
+    char magic[8];
+    int pid;
+    int thread_count;
+    int worker_count;
+    long long run_id;
+    long long target_iter_count;
+    double start_time;
+} __attribute__((aligned(CACHE_LINE_SIZE))) telemetry_header_t;
+
+typedef struct telemetry_s {
+    const char* name;
+    int owner;
+    size_t size;
+    telemetry_header_t* header;
+    telemetry_slot_t* slots;
+} telemetry_t;
+
+/*
+ * Function creates shared memory segment with POSIX name
+ * ("/name") for thread_count workers.
+ * Returns SUCCESS or error code.
+ */
+int telemetry_create(telemetry_t* telemetry, const char* name, int thread_count);
+
+/*
+ * Function maps existing segment read-only.
+ * Returns SUCCESS or error code.
+ */
+int telemetry_attach(telemetry_t* telemetry, const char* name);
+
+/*
+ * Function zeroes all slots and starts a new run of target_iter_count
+ * iterations by the first worker_count workers. Workers must not be
+ * publishing at the time.
+ */
+void telemetry_start_run(telemetry_t* telemetry, int worker_count,
+        long long target_iter_count);
+
+/*
+ * Function adds iter_count to the slot of thread_id and stamps it
+ * with current time. Must be called only by the owner of the slot.
+ */
+void telemetry_add(telemetry_t* telemetry, int thread_id, long long iter_count);
+
+/*
+ * Function unmaps the segment. The segment is also removed if it was
+ * created by telemetry_create().
+ */
+void telemetry_destroy(telemetry_t* telemetry);
+
+#endif /* telemetry_h */
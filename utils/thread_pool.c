@@ -0,0 +1,286 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+#define TASKS_PER_WORKER 64
+
+/*
+ * Workers wait on a single condition, so a task for a particular worker
+ * has to wake up all of them. Submitters to the queue and to particular
+ * workers share not_full the same way. A retiring worker leaves
+ * as soon as it has no task of its own.
+ */
+static int take_task(pool_worker_t* worker, pool_task_t* task) {
+    thread_pool_t* pool = worker->pool;
+    pthread_mutex_lock(&pool->mutex);
+    while (!worker->has_own_task && pool->size == 0 && !pool->stopping &&
+            !worker->retiring) {
+        pthread_cond_wait(&pool->not_empty, &pool->mutex);
+    }
+    if (worker->has_own_task) {
+        *task = worker->own_task;
+        worker->has_own_task = 0;
+        pthread_cond_broadcast(&pool->not_full);
+        pthread_mutex_unlock(&pool->mutex);
+        return SUCCESS;
+    }
+    if (pool->size == 0 || worker->retiring) {
+        pthread_mutex_unlock(&pool->mutex);
+        return FAILURE;
+    }
+    *task = pool->tasks[pool->head];
+    pool->head = (pool->head + 1) % pool->capacity;
+    pool->size--;
+    pthread_cond_broadcast(&pool->not_full);
+    pthread_mutex_unlock(&pool->mutex);
+    return SUCCESS;
+}
+
+/*
+ * Local memory is page aligned, so that pages touched by a worker
+ * hold only its own data.
+ */
+static void allocate_local(pool_worker_t* worker) {
+    size_t size = worker->pool->local_size;
+    if (size == 0) {
+        return;
+    }
+    if (posix_memalign(&worker->local, sysconf(_SC_PAGESIZE), size) == SUCCESS) {
+        memset(worker->local, 0, size);
+    } else {
+        worker->local = NULL;
+    }
+}
+
+static void* worker_routine(void* arg) {
+    pool_worker_t* worker = (pool_worker_t*) arg;
+    allocate_local(worker);
+    latch_count_down(&worker->pool->started);
+
+    pool_task_t task;
+    while (take_task(worker, &task) == SUCCESS) {
+        task.routine(task.arg, worker);
+        if (task.latch != NULL) {
+            latch_count_down(task.latch);
+        }
+    }
+    return NO_RETURN_VALUE;
+}
+
+static void stop_workers(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->worker_count; ++i) {
+        pthread_join(pool->workers[i].thread, NO_RETURN_VALUE);
+    }
+}
+
+static void free_pool(thread_pool_t* pool) {
+    for (int i = 0; i < pool->worker_count; ++i) {
+        free(pool->workers[i].local);
+    }
+    latch_destroy(&pool->started);
+    pthread_cond_destroy(&pool->not_full);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool->tasks);
+}
+
+static int create_worker(pool_worker_t* worker, int cpu) {
+    pthread_attr_t attr;
+    int code = pthread_attr_init(&attr);
+    if (code != SUCCESS) {
+        return code;
+    }
+    if (cpu >= 0) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        code = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set), &cpu_set);
+    }
+    if (code == SUCCESS) {
+        code = pthread_create(&worker->thread, &attr, worker_routine,
+                              (void*) worker);
+    }
+    pthread_attr_destroy(&attr);
+    return code;
+}
+
+/*
+ * Function stops workers [from, to) and frees their local memory.
+ * Their results are added to the first worker, so that gathering
+ * still sees them.
+ */
+static void remove_workers(thread_pool_t* pool, int from, int to) {
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = from; i < to; ++i) {
+        pool->workers[i].retiring = 1;
+    }
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = from; i < to; ++i) {
+        pool_worker_t* worker = pool->workers + i;
+        pthread_join(worker->thread, NO_RETURN_VALUE);
+        free(worker->local);
+        worker->local = NULL;
+        if (i > 0) {
+            pool->workers[0].result += worker->result;
+        }
+    }
+}
+
+/*
+ * Function starts workers from worker_count up to count and waits until
+ * they have allocated local memory. If some of them can not be started
+ * or get no memory, the started ones are stopped again.
+ * Returns SUCCESS or error code.
+ */
+static int add_workers(thread_pool_t* pool, int count) {
+    int first = pool->worker_count;
+    latch_reset(&pool->started, count - first);
+    int code = SUCCESS;
+    int started_count = first;
+    for ( ; started_count < count; ++started_count) {
+        pool_worker_t* worker = pool->workers + started_count;
+        worker->result = 0;
+        worker->local = NULL;
+        worker->has_own_task = 0;
+        worker->retiring = 0;
+        code = create_worker(worker, worker->cpu);
+        if (code != SUCCESS) {
+            break;
+        }
+    }
+    if (code == SUCCESS) {
+        latch_wait(&pool->started);
+        for (int i = first; i < count; ++i) {
+            if (pool->local_size != 0 && pool->workers[i].local == NULL) {
+                code = ENOMEM;
+            }
+        }
+    }
+    if (code != SUCCESS) {
+        remove_workers(pool, first, started_count);
+        return code;
+    }
+    pool->worker_count = count;
+    return SUCCESS;
+}
+
+int thread_pool_init(thread_pool_t* pool, int worker_count) {
+    return thread_pool_init_pinned(pool, worker_count, NULL, 0);
+}
+
+int thread_pool_init_pinned(thread_pool_t* pool, int worker_count,
+        const int* cpus, size_t local_size) {
+    return thread_pool_init_elastic(pool, worker_count, worker_count, cpus,
+                                    local_size);
+}
+
+int thread_pool_init_elastic(thread_pool_t* pool, int worker_count,
+        int max_worker_count, const int* cpus, size_t local_size) {
+    pool->capacity = max_worker_count * TASKS_PER_WORKER;
+    pool->head = 0;
+    pool->size = 0;
+    pool->stopping = 0;
+    pool->worker_count = 0;
+    pool->max_worker_count = max_worker_count;
+    pool->local_size = local_size;
+    pool->tasks = (pool_task_t*)malloc(pool->capacity * sizeof(pool_task_t));
+    void* workers = NULL;
+    int code = posix_memalign(&workers, CACHE_LINE_SIZE,
+                              max_worker_count * sizeof(pool_worker_t));
+    pool->workers = (pool_worker_t*) workers;
+    if (pool->tasks == NULL || code != SUCCESS) {
+        free(pool->tasks);
+        free(workers);
+        return ENOMEM;
+    }
+    code = latch_init(&pool->started, 0);
+    if (code != SUCCESS) {
+        free(pool->tasks);
+        free(workers);
+        return code;
+    }
+    pthread_mutex_init(&pool->mutex, DEFAULT_ATTR);
+    pthread_cond_init(&pool->not_empty, DEFAULT_ATTR);
+    pthread_cond_init(&pool->not_full, DEFAULT_ATTR);
+
+    for (int i = 0; i < max_worker_count; ++i) {
+        pool_worker_t* worker = pool->workers + i;
+        worker->pool = pool;
+        worker->id = i;
+        worker->cpu = cpus != NULL ? cpus[i] : -1;
+    }
+    code = add_workers(pool, worker_count);
+    if (code != SUCCESS) {
+        free_pool(pool);
+        return code;
+    }
+    return SUCCESS;
+}
+
+int thread_pool_resize(thread_pool_t* pool, int worker_count) {
+    if (worker_count < 1 || worker_count > pool->max_worker_count) {
+        return EINVAL;
+    }
+    if (worker_count > pool->worker_count) {
+        return add_workers(pool, worker_count);
+    }
+    remove_workers(pool, worker_count, pool->worker_count);
+    pool->worker_count = worker_count;
+    return SUCCESS;
+}
+
+void thread_pool_submit(thread_pool_t* pool, task_routine_t routine, void* arg,
+        latch_t* latch) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->size == pool->capacity) {
+        pthread_cond_wait(&pool->not_full, &pool->mutex);
+    }
+    pool_task_t* task = pool->tasks + (pool->head + pool->size) % pool->capacity;
+    task->routine = routine;
+    task->arg = arg;
+    task->latch = latch;
+    pool->size++;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void thread_pool_submit_to(thread_pool_t* pool, int worker_id,
+        task_routine_t routine, void* arg, latch_t* latch) {
+    pool_worker_t* worker = pool->workers + worker_id;
+    pthread_mutex_lock(&pool->mutex);
+    while (worker->has_own_task) {
+        pthread_cond_wait(&pool->not_full, &pool->mutex);
+    }
+    worker->own_task.routine = routine;
+    worker->own_task.arg = arg;
+    worker->own_task.latch = latch;
+    worker->has_own_task = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+double thread_pool_gather_results(thread_pool_t* pool) {
+    double result = 0;
+    for (int i = 0; i < pool->worker_count; ++i) {
+        result += pool->workers[i].result;
+        pool->workers[i].result = 0;
+    }
+    return result;
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    stop_workers(pool);
+    free_pool(pool);
+}
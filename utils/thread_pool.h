@@ -0,0 +1,130 @@
+#ifndef thread_pool_h
+#define thread_pool_h
+
+#include <pthread.h>
+#include <stddef.h>
+#include "util.h"
+#include "latch.h"
+
+struct thread_pool_s;
+struct pool_worker_s;
+
+/*
+ * Task routine gets its argument and the worker running it.
+ * Tasks accumulate their results in worker->result.
+ */
+typedef void (*task_routine_t)(void* arg, struct pool_worker_s* worker);
+
+typedef struct pool_task_s {
+    task_routine_t routine;
+    void* arg;
+    latch_t* latch;
+} pool_task_t;
+
+/*
+ * Worker descriptor. It takes whole cache lines, so result slots
+ * of different workers never share one.
+ * cpu is the CPU the worker is pinned to or -1. local is memory of
+ * local_size bytes allocated and zeroed by the worker itself, so with
+ * first-touch policy it is placed on the NUMA node of the worker.
+ * own_task is a task submitted to this worker only. A retiring worker
+ * is being removed from the pool.
+ */
+typedef struct pool_worker_s {
+    struct thread_pool_s* pool;
+    pthread_t thread;
+    int id;
+    int cpu;
+    double result;
+    void* local;
+    int has_own_task;
+    pool_task_t own_task;
+    int retiring;
+} __attribute__((aligned(CACHE_LINE_SIZE))) pool_worker_t;
+
+/*
+ * Set of workers taking tasks from a bounded FIFO queue. A task
+ * submitted to a particular worker is taken before the queue.
+ * Workers [0, worker_count) are running, descriptors of up to
+ * max_worker_count workers are allocated, so the pool can grow
+ * without moving them.
+ */
+typedef struct thread_pool_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pool_task_t* tasks;
+    int capacity;
+    int head;
+    int size;
+    int stopping;
+    int worker_count;
+    int max_worker_count;
+    size_t local_size;
+    latch_t started;
+    pool_worker_t* workers;
+} thread_pool_t;
+
+/*
+ * Function starts worker_count workers that are not pinned
+ * and have no local memory.
+ * Returns SUCCESS or error code.
+ */
+int thread_pool_init(thread_pool_t* pool, int worker_count);
+
+/*
+ * Function starts worker_count workers, worker i is pinned to cpus[i]
+ * unless cpus is NULL. Every worker allocates local_size bytes of local
+ * memory before the function returns, if local_size is not zero.
+ * Returns SUCCESS or error code.
+ */
+int thread_pool_init_pinned(thread_pool_t* pool, int worker_count,
+        const int* cpus, size_t local_size);
+
+/*
+ * Same as thread_pool_init_pinned(), but the pool can be resized
+ * up to max_worker_count workers. Worker i is pinned to cpus[i] unless
+ * cpus is NULL, so cpus has max_worker_count entries.
+ * Returns SUCCESS or error code.
+ */
+int thread_pool_init_elastic(thread_pool_t* pool, int worker_count,
+        int max_worker_count, const int* cpus, size_t local_size);
+
+/*
+ * Function starts or stops workers at the end of the pool, so that
+ * worker_count of them are running. Started workers allocate local
+ * memory anew, results of stopped workers are kept in worker 0.
+ * Must be called when no task is queued or running.
+ * Returns SUCCESS, EINVAL if worker_count is not in [1, max_worker_count]
+ * or error code; the pool is not changed on error.
+ */
+int thread_pool_resize(thread_pool_t* pool, int worker_count);
+
+/*
+ * Function queues routine(arg, worker) to be run by some worker.
+ * If latch is not NULL it is counted down after the routine returns.
+ * Blocks while the queue is full.
+ */
+void thread_pool_submit(thread_pool_t* pool, task_routine_t routine, void* arg,
+        latch_t* latch);
+
+/*
+ * Function queues routine(arg, worker) to be run by the worker
+ * with worker_id. Blocks while that worker has a task of its own
+ * that is not taken yet.
+ */
+void thread_pool_submit_to(thread_pool_t* pool, int worker_id,
+        task_routine_t routine, void* arg, latch_t* latch);
+
+/*
+ * Function returns sum of result slots of all workers and zeroes them.
+ * Must be called when no task is running.
+ */
+double thread_pool_gather_results(thread_pool_t* pool);
+
+/*
+ * Function runs all queued tasks, stops workers and frees resources.
+ */
+void thread_pool_destroy(thread_pool_t* pool);
+
+#endif /* thread_pool_h */
@@ -0,0 +1,75 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdlib.h>
+#include <unistd.h>
+#include "futex.h"
+#include "turnstile.h"
+
+/*
+ * Rounds a waiter polls the ticket before it parks. On a single CPU
+ * the participant it waits for can not run meanwhile, so it parks
+ * at once.
+ */
+#define SPIN_COUNT 1000
+
+static int is_turn_of(turnstile_t* turnstile, int participant_id) {
+    long long ticket = __atomic_load_n(&turnstile->ticket, __ATOMIC_SEQ_CST);
+    return ticket % turnstile->participant_count == participant_id;
+}
+
+int turnstile_init(turnstile_t* turnstile, int participant_count) {
+    void* slots = NULL;
+    int code = posix_memalign(&slots, CACHE_LINE_SIZE,
+                              participant_count * sizeof(turnstile_slot_t));
+    if (code != SUCCESS) {
+        return code;
+    }
+    turnstile->slots = (turnstile_slot_t*) slots;
+    turnstile->ticket = 0;
+    turnstile->participant_count = participant_count;
+    turnstile->spin_count = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_COUNT : 0;
+    for (int i = 0; i < participant_count; ++i) {
+        turnstile->slots[i].parked = 0;
+    }
+    return SUCCESS;
+}
+
+/*
+ * The waiter announces that it parks and only then checks the ticket
+ * once more, the passer moves the ticket and only then looks for
+ * a parked waiter. Both are sequentially consistent, so either the
+ * waiter sees its turn or the passer sees it parked and wakes it.
+ */
+void turnstile_wait(turnstile_t* turnstile, int participant_id) {
+    for (int i = 0; i < turnstile->spin_count; ++i) {
+        if (is_turn_of(turnstile, participant_id)) {
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    int* parked = &turnstile->slots[participant_id].parked;
+    while (!is_turn_of(turnstile, participant_id)) {
+        __atomic_store_n(parked, 1, __ATOMIC_SEQ_CST);
+        if (is_turn_of(turnstile, participant_id)) {
+            __atomic_store_n(parked, 0, __ATOMIC_RELAXED);
+            return;
+        }
+        futex_wait(parked, 1);
+    }
+}
+
+void turnstile_pass(turnstile_t* turnstile, int participant_id) {
+    __atomic_fetch_add(&turnstile->ticket, 1, __ATOMIC_SEQ_CST);
+    int next = (participant_id + 1) % turnstile->participant_count;
+    int* parked = &turnstile->slots[next].parked;
+    if (__atomic_exchange_n(parked, 0, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(parked, 1);
+    }
+}
+
+void turnstile_destroy(turnstile_t* turnstile) {
+    free(turnstile->slots);
+}
@@ -0,0 +1,48 @@
+#ifndef turnstile_h
+#define turnstile_h
+
+#include "util.h"
+
+/*
+ * Parking place of a participant. parked is the futex word the
+ * participant sleeps on, it is set only while the participant
+ * is about to sleep or sleeping.
+ */
+typedef struct turnstile_slot_s {
+    int parked;
+} __attribute__((aligned(CACHE_LINE_SIZE))) turnstile_slot_t;
+
+/*
+ * Ordered turnstile: participants 0, 1, ..., participant_count - 1
+ * pass it in strict round-robin order. ticket counts the turns taken,
+ * participant ticket mod participant_count is the one to go. Every
+ * participant parks on its own slot, so passing the turn wakes only
+ * the next participant, and only if it sleeps.
+ */
+typedef struct turnstile_s {
+    long long ticket __attribute__((aligned(CACHE_LINE_SIZE)));
+    int participant_count;
+    int spin_count;
+    turnstile_slot_t* slots;
+} turnstile_t;
+
+/*
+ * Function initializes turnstile for participant_count participants,
+ * participant 0 goes first. Returns SUCCESS or error code.
+ */
+int turnstile_init(turnstile_t* turnstile, int participant_count);
+
+/*
+ * Function blocks until it is the turn of participant_id.
+ */
+void turnstile_wait(turnstile_t* turnstile, int participant_id);
+
+/*
+ * Function ends the turn of participant_id, which must be
+ * the current one, and lets the next participant go.
+ */
+void turnstile_pass(turnstile_t* turnstile, int participant_id);
+
+void turnstile_destroy(turnstile_t* turnstile);
+
+#endif /* turnstile_h */
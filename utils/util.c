@@ -1,6 +1,10 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "util.h"
 
 void exit_with_cleanup(int code, void (*cleanup_routine)(void*), void* arg) {
@@ -50,3 +54,9 @@ void exit_if_true_with_message(int expression, char* message) {
         exit(EXIT_FAILURE);
     }
 }
+
+double get_time_in_seconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
@@ -7,6 +7,7 @@
 #define DEFAULT_ATTR NULL
 #define SUCCESS 0
 #define FAILURE 1
+#define CACHE_LINE_SIZE 64
 
 
 /*
@@ -58,4 +59,9 @@ void exit_with_custom_message(const char* message, int code);
  */
 void exit_if_true_with_message(int expression, char* message);
 
+/*
+ * Function returns value of monotonic clock in seconds.
+ */
+double get_time_in_seconds();
+
 #endif /* util_h */